@@ -0,0 +1,57 @@
+#pragma once
+
+// standard
+#include <iterator>
+#include <map>
+
+// glad
+#include <glad/glad.h>
+
+// First-fit free list over [0, capacity). Free blocks are kept sorted by
+// offset so a released block merges with its neighbours.
+class RangeAllocator {
+ public:
+  GLuint capacity;
+
+  RangeAllocator(GLuint capacity) : capacity(capacity) {
+    if (capacity) free_blocks[0] = capacity;
+  }
+
+  bool allocate(GLuint size, GLuint &offset) {
+    if (!size) {
+      offset = 0;
+      return true;
+    }
+    for (auto it = free_blocks.begin(); it != free_blocks.end(); ++it) {
+      if (it->second < size) continue;
+      offset = it->first;
+      GLuint left = it->second - size;
+      free_blocks.erase(it);
+      if (left) free_blocks[offset + size] = left;
+      return true;
+    }
+    return false;
+  }
+
+  void release(GLuint offset, GLuint size) {
+    if (!size) return;
+    auto next = free_blocks.lower_bound(offset);
+    // merge with the following block
+    if (next != free_blocks.end() && offset + size == next->first) {
+      size += next->second;
+      next = free_blocks.erase(next);
+    }
+    // merge with the preceding block
+    if (next != free_blocks.begin()) {
+      auto prev = std::prev(next);
+      if (prev->first + prev->second == offset) {
+        prev->second += size;
+        return;
+      }
+    }
+    free_blocks[offset] = size;
+  }
+
+ private:
+  std::map<GLuint, GLuint> free_blocks;  // offset -> size
+};
@@ -0,0 +1,173 @@
+#pragma once
+
+// standard
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <utility>
+
+// glad
+#include <glad/glad.h>
+
+// helpers
+#include "allocator.hpp"
+#include "buffers.hpp"
+#include "deletion.hpp"
+#include "span.hpp"
+#include "trace.hpp"
+#include "vertex.hpp"
+
+// default page capacity, in vertices and indices; larger meshes get a page of
+// their own size
+const GLuint ARENA_PAGE_VERTICES = 1 << 16;
+const GLuint ARENA_PAGE_INDICES = 1 << 18;
+
+// size of one index of a GL index type
+GLsizei index_size(GLenum index_type) {
+  return index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+// One vertex buffer and one index buffer shared by every mesh of a vertex
+// format and index type, with a vertex array set up once for that format.
+// Meshes draw their range with a base vertex and first index.
+class ArenaPage {
+ public:
+  VAO vao;
+  VBO vbo;
+  EBO ebo;
+  const VertexFormat *format;
+  GLsizei stride;
+  GLenum index_type;
+  RangeAllocator vertices, indices;
+
+  ArenaPage(const VertexFormat &format, GLenum index_type,
+            GLuint vertex_capacity, GLuint index_capacity)
+      : vbo(vertex_capacity * format.stride),
+        ebo(index_capacity * index_size(index_type)),
+        format(&format),
+        stride(format.stride),
+        index_type(index_type),
+        vertices(vertex_capacity),
+        indices(index_capacity) {
+    format.load();
+  }
+};
+
+// indices of an arena page that draw on their own, offset by base_vertex
+struct ArenaRange {
+  ArenaPage *page;
+  GLuint first_index;
+  GLuint index_count;
+  GLint base_vertex;
+};
+
+// where a mesh lives inside the arena. The ranges hold `*_capacity`
+// elements, of which the first `*_count` are in use.
+struct ArenaAllocation {
+  ArenaPage *page = NULL;
+  GLuint first_vertex = 0;
+  GLuint vertex_count = 0;
+  GLuint vertex_capacity = 0;
+  GLuint first_index = 0;
+  GLuint index_count = 0;
+  GLuint index_capacity = 0;
+
+  // `index_count` indices starting `index_offset` into the allocation,
+  // referring to vertices starting `vertex_offset` into it
+  ArenaRange range(GLuint index_offset, GLuint index_count,
+                   GLuint vertex_offset) const {
+    return {page, first_index + index_offset, index_count,
+            GLint(first_vertex + vertex_offset)};
+  }
+  ArenaRange range() const { return range(0, this->index_count, 0); }
+
+  // whether new contents of this size and format can be written in place
+  bool fits(const VertexFormat &format, GLuint vertices, GLenum index_type,
+            GLuint indices) const {
+    return page && page->format == &format && page->index_type == index_type &&
+           vertices <= vertex_capacity && indices <= index_capacity;
+  }
+};
+
+// Sub-allocates mesh vertex and index data out of a few large buffers, one
+// set of pages per vertex format and index type.
+class BufferArena {
+ public:
+  // reserve room for `vertex_capacity` vertices laid out as `format` and
+  // `index_capacity` indices of `index_type`, without writing anything
+  ArenaAllocation allocate(const VertexFormat &format, GLenum index_type,
+                           GLuint vertex_capacity, GLuint index_capacity) {
+    ArenaAllocation a;
+    a.vertex_capacity = vertex_capacity;
+    a.index_capacity = index_capacity;
+
+    auto &pages = formats[std::make_pair(&format, index_type)];
+    for (auto &page : pages)
+      if (reserve(page, a)) break;
+    if (!a.page) {
+      pages.emplace_back(format, index_type,
+                         std::max(vertex_capacity, ARENA_PAGE_VERTICES),
+                         std::max(index_capacity, ARENA_PAGE_INDICES));
+      reserve(pages.back(), a);
+    }
+    return a;
+  }
+
+  // `vertices` holds `vertex_count` vertices laid out as `format`, and
+  // `indices` holds `index_count` indices of `index_type`
+  ArenaAllocation allocate(const VertexFormat &format, const void *vertices,
+                           GLuint vertex_count, GLenum index_type,
+                           const void *indices, GLuint index_count) {
+    ArenaAllocation a =
+        allocate(format, index_type, vertex_count, index_count);
+    write(a, vertices, vertex_count, indices, index_count);
+    return a;
+  }
+
+  // replace the contents of an allocation, which must fit() them
+  void write(ArenaAllocation &a, const void *vertices, GLuint vertex_count,
+             const void *indices, GLuint index_count) {
+    TraceScope trace("arena upload", "gl");
+    GLsizei stride = a.page->stride;
+    GLsizei index_bytes = index_size(a.page->index_type);
+    a.vertex_count = vertex_count;
+    a.index_count = index_count;
+    a.page->vbo.update(a.first_vertex * stride, vertex_count * stride,
+                       vertices);
+    a.page->vao.bind();
+    a.page->ebo.update(a.first_index * index_bytes, index_count * index_bytes,
+                       indices);
+  }
+
+  // the ranges become reusable once the GPU is done with them
+  void release(ArenaAllocation &a) {
+    if (!a.page) return;
+    deletion_queue.retire_range(&a.page->vertices, a.first_vertex,
+                                a.vertex_capacity);
+    deletion_queue.retire_range(&a.page->indices, a.first_index,
+                                a.index_capacity);
+    a.page = NULL;
+  }
+
+  // free all pages; ranges retired from them must have been flushed out of
+  // the deletion queue already
+  void clear() { formats.clear(); }
+
+ private:
+  // a deque never moves its pages, which allocations point to
+  std::map<std::pair<const VertexFormat *, GLenum>, std::deque<ArenaPage>>
+      formats;
+
+  bool reserve(ArenaPage &page, ArenaAllocation &a) {
+    if (!page.vertices.allocate(a.vertex_capacity, a.first_vertex))
+      return false;
+    if (!page.indices.allocate(a.index_capacity, a.first_index)) {
+      page.vertices.release(a.first_vertex, a.vertex_capacity);
+      return false;
+    }
+    a.page = &page;
+    return true;
+  }
+};
+
+BufferArena arena;
@@ -0,0 +1,331 @@
+#pragma once
+
+// standard
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+// glad
+#include <glad/glad.h>
+
+// glm
+#include <glm/glm.hpp>
+
+// helpers
+#include "arena.hpp"
+#include "glstate.hpp"
+#include "shader.hpp"
+#include "stats.hpp"
+#include "stream.hpp"
+#include "trace.hpp"
+
+// texture units of the batch lookup buffers; unit 0 stays the mesh texture
+const int MODELS_UNIT = 1;
+const int DRAW_VERTICES_UNIT = 2;
+// vertex attribute carrying the draw id on the indirect path
+const GLuint DRAW_ID_ATTRIBUTE = 7;
+
+// layout mandated by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+// one draw of a batch: an index range plus its model matrix
+struct BatchDraw {
+  GLuint count;
+  GLuint first_index;
+  GLint base_vertex;
+  glm::mat4 model;
+};
+
+// Submits many draws that share program, vertex array, texture and primitive
+// mode with one call. Model matrices go into a texture buffer that the vertex
+// shader indexes by draw id.
+//
+// With GL 4.3 the draws become a DrawElementsIndirectCommand buffer for
+// glMultiDrawElementsIndirect, and the draw id reaches the shader through an
+// instanced attribute offset by baseInstance. On GL 3.3 the fallback is
+// glMultiDrawElementsBaseVertex; since gl_VertexID includes the base vertex
+// and the draws of a batch occupy disjoint vertex ranges, the shader finds its
+// draw id by binary search over the sorted first vertices. That search can
+// not tell apart draws sharing a base vertex, such as meshes showing the same
+// arena range, so those go out with glDrawElementsInstancedBaseVertex
+// instead, one call per index range, and the draw id is the first draw of
+// the call plus gl_InstanceID.
+//
+// The texture buffers view only the slice of a batch, through
+// glTexBufferRange, so they stay below GL_MAX_TEXTURE_BUFFER_SIZE however
+// large the stream buffer grows; batches too big for that limit go out in
+// several calls. Without glTexBufferRange the slice is copied into a buffer
+// of the batcher's own.
+class DrawBatcher {
+ public:
+  bool indirect = false;  // glMultiDrawElementsIndirect available
+  bool ranged = false;    // glTexBufferRange available
+  std::vector<BatchDraw> draws;
+
+  void init() {
+#ifdef GL_VERSION_4_3
+    indirect = GLAD_GL_VERSION_4_3;
+    ranged = GLAD_GL_VERSION_4_3;
+#endif
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+    if (ranged) glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment = std::max<GLint>(alignment, 16);
+    glGenTextures(1, &models_texture);
+    glGenTextures(1, &draw_vertices_texture);
+    if (indirect) glGenBuffers(1, &draw_ids_buffer);
+    if (!ranged) {
+      glGenBuffers(1, &lookup_buffer);
+      gl_state.bind_buffer(GL_TEXTURE_BUFFER, lookup_buffer);
+      glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+      bind_texture(MODELS_UNIT, models_texture);
+      glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lookup_buffer);
+      bind_texture(DRAW_VERTICES_UNIT, draw_vertices_texture);
+      glTexBuffer(GL_TEXTURE_BUFFER, GL_R32I, lookup_buffer);
+      gl_state.active_texture(GL_TEXTURE0);
+    }
+  }
+
+  // the GL objects are released by destroy(), while the context is alive
+  ~DrawBatcher() {
+    if (models_texture)
+      std::fprintf(stderr, "DrawBatcher leaked, destroy() not called\n");
+  }
+
+  // must run while the GL context is still alive
+  void destroy() {
+    GLuint textures[] = {models_texture, draw_vertices_texture};
+    glDeleteTextures(2, textures);
+    for (auto id : textures) gl_state.forget_texture(id);
+    for (GLuint id : {draw_ids_buffer, lookup_buffer}) {
+      if (!id) continue;
+      glDeleteBuffers(1, &id);
+      gl_state.forget_buffer(id);
+    }
+    models_texture = draw_vertices_texture = 0;
+    draw_ids_buffer = lookup_buffer = 0;
+    draw_ids_size = 0;
+  }
+
+  void clear() { draws.clear(); }
+  void add(GLuint count, GLuint first_index, GLint base_vertex,
+           const glm::mat4 &model) {
+    draws.push_back({count, first_index, base_vertex, model});
+  }
+
+  // submit the collected draws with the program and vertex array already
+  // bound; `shader` gets the batch uniforms and `index_type` is the type of
+  // the vertex array's index buffer.
+  void submit(Shader &shader, GLenum mode, GLenum index_type) {
+    if (draws.empty()) return;
+    TraceScope trace("batch submit", "gl");
+
+    // the vertex search needs the draws in vertex order, and draws of the
+    // same index range next to each other
+    if (!indirect)
+      std::sort(draws.begin(), draws.end(),
+                [](const BatchDraw &a, const BatchDraw &b) {
+                  if (a.base_vertex != b.base_vertex)
+                    return a.base_vertex < b.base_vertex;
+                  if (a.first_index != b.first_index)
+                    return a.first_index < b.first_index;
+                  return a.count < b.count;
+                });
+
+    // draws per call that keep both views under the texel limit; the
+    // draw vertices view has the smaller texels
+    GLsizeiptr texel = indirect ? sizeof(glm::vec4) : sizeof(GLint);
+    GLsizei most = std::max<GLsizeiptr>(1, max_texels * texel / draw_bytes());
+
+    shader.setBool("batched", true);
+    shader.setBool("indirect", indirect);
+    for (GLsizei first = 0; first < GLsizei(draws.size()); first += most)
+      submit_part(shader, mode, index_type, first,
+                  std::min<GLsizei>(most, draws.size() - first));
+    shader.setBool("batched", false);
+    gl_state.active_texture(GL_TEXTURE0);
+  }
+
+ private:
+  GLuint models_texture = 0, draw_vertices_texture = 0;
+  GLuint draw_ids_buffer = 0;
+  GLsizei draw_ids_size = 0;
+  // texel limit and offset alignment of texture buffers
+  GLint max_texels = 65536;
+  GLint alignment = 16;
+  // copy of the per-draw data without glTexBufferRange, and its storage
+  GLuint lookup_buffer = 0;
+  std::vector<char> lookup;
+  std::vector<GLsizei> counts;
+  std::vector<const void *> offsets;
+  std::vector<GLint> base_vertices;
+
+  // bytes of per-draw data: a model matrix, then a draw command or a
+  // first vertex
+  GLsizeiptr draw_bytes() const {
+    return sizeof(glm::mat4) +
+           (indirect ? sizeof(DrawElementsIndirectCommand) : sizeof(GLint));
+  }
+
+  void bind_texture(int unit, GLuint texture) {
+    gl_state.active_texture(GL_TEXTURE0 + unit);
+    gl_state.bind_texture(GL_TEXTURE_BUFFER, texture);
+  }
+
+  // Draws [first, first + n) with their per-draw data in one stream slice:
+  // the model matrices followed by the draw commands or first vertices. A
+  // single slice can not be split by the stream buffer orphaning or growing
+  // in between. Both texture buffers view just that slice, so the matrices
+  // start at texel 0.
+  void submit_part(Shader &shader, GLenum mode, GLenum index_type,
+                   GLsizei first, GLsizei n) {
+    GLsizeiptr bytes = n * draw_bytes();
+    StreamSlice slice;
+    if (ranged) {
+      slice = stream.alloc(bytes, alignment);
+    } else {
+      lookup.resize(bytes);
+      slice = {lookup.data(), lookup_buffer, 0};
+    }
+    glm::mat4 *models = (glm::mat4 *)slice.data;
+    for (GLsizei i = 0; i < n; i++) models[i] = draws[first + i].model;
+    void *rest = models + n;
+    if (indirect)
+      write_commands(rest, first, n);
+    else
+      write_first_vertices(rest, first, n);
+
+    if (ranged) {
+      stream.flush();
+#ifdef GL_VERSION_4_3
+      bind_texture(MODELS_UNIT, models_texture);
+      glTexBufferRange(GL_TEXTURE_BUFFER, GL_RGBA32F, slice.buffer,
+                       slice.offset, bytes);
+      if (!indirect) {
+        bind_texture(DRAW_VERTICES_UNIT, draw_vertices_texture);
+        glTexBufferRange(GL_TEXTURE_BUFFER, GL_R32I, slice.buffer,
+                         slice.offset, bytes);
+      }
+#endif
+    } else {
+      // orphan the old storage so the driver never waits for the last call
+      gl_state.bind_buffer(GL_TEXTURE_BUFFER, lookup_buffer);
+      glBufferData(GL_TEXTURE_BUFFER, bytes, lookup.data(), GL_STREAM_DRAW);
+      render_stats.buffer_bytes += bytes;
+    }
+
+    GLintptr rest_offset = slice.offset + n * sizeof(glm::mat4);
+    if (indirect) {
+      submit_indirect(mode, index_type, n, slice.buffer, rest_offset);
+    } else {
+      shader.setInt("draw_vertices_base", n * sizeof(glm::mat4) / 4);
+      submit_base_vertex(shader, mode, index_type, first, n);
+    }
+  }
+
+  void write_commands(void *data, GLsizei first, GLsizei n) {
+    auto *commands = (DrawElementsIndirectCommand *)data;
+    for (GLsizei i = 0; i < n; i++) {
+      auto &d = draws[first + i];
+      commands[i] = {d.count, 1, d.first_index, d.base_vertex, (GLuint)i};
+    }
+  }
+
+  void write_first_vertices(void *data, GLsizei first, GLsizei n) {
+    GLint *first_vertices = (GLint *)data;
+    for (GLsizei i = 0; i < n; i++)
+      first_vertices[i] = draws[first + i].base_vertex;
+  }
+
+  void submit_indirect(GLenum mode, GLenum index_type, GLsizei n,
+                       GLuint buffer, GLintptr offset) {
+#ifdef GL_VERSION_4_3
+    // draw ids 0..n-1, read per instance starting at baseInstance
+    if (draw_ids_size < n) {
+      std::vector<GLint> ids(n);
+      for (GLsizei i = 0; i < n; i++) ids[i] = i;
+      gl_state.bind_buffer(GL_ARRAY_BUFFER, draw_ids_buffer);
+      glBufferData(GL_ARRAY_BUFFER, n * sizeof(GLint), ids.data(),
+                   GL_STATIC_DRAW);
+      render_stats.buffer_bytes += n * sizeof(GLint);
+      draw_ids_size = n;
+    }
+    // attribute state lives in the bound vertex array
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, draw_ids_buffer);
+    glVertexAttribIPointer(DRAW_ID_ATTRIBUTE, 1, GL_INT, 0, 0);
+    glVertexAttribDivisor(DRAW_ID_ATTRIBUTE, 1);
+    glEnableVertexAttribArray(DRAW_ID_ATTRIBUTE);
+
+    gl_state.bind_buffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+    glMultiDrawElementsIndirect(mode, index_type, (void *)offset, n, 0);
+    render_stats.draw_calls++;
+#endif
+  }
+
+  // end of the run of draws from `i` on, before `end`, that share the base
+  // vertex of draw i and, with `same_range`, its index range too
+  GLsizei run_end(GLsizei i, GLsizei end, bool same_range) const {
+    const BatchDraw &d = draws[i];
+    GLsizei j = i + 1;
+    while (j < end && draws[j].base_vertex == d.base_vertex &&
+           (!same_range || (draws[j].first_index == d.first_index &&
+                            draws[j].count == d.count)))
+      j++;
+    return j;
+  }
+
+  void submit_base_vertex(Shader &shader, GLenum mode, GLenum index_type,
+                          GLsizei first, GLsizei n) {
+    GLsizei index_bytes = index_size(index_type);
+    GLsizei end = first + n;
+    counts.clear();
+    offsets.clear();
+    base_vertices.clear();
+    bool shared = false;
+    for (GLsizei i = first; i < end; i = run_end(i, end, false)) {
+      if (run_end(i, end, false) > i + 1) {
+        shared = true;
+        continue;
+      }
+      auto &d = draws[i];
+      base_vertices.push_back(d.base_vertex);
+      counts.push_back(d.count);
+      offsets.push_back((const void *)(size_t)(d.first_index * index_bytes));
+    }
+    shader.setInt("draw_count", n);
+
+    if (!counts.empty()) {
+      glMultiDrawElementsBaseVertex(mode, counts.data(), index_type,
+                                    offsets.data(), counts.size(),
+                                    base_vertices.data());
+      render_stats.draw_calls++;
+    }
+    if (!shared) return;
+
+    // draws sharing a base vertex, drawn per index range as instances
+    shader.setBool("instanced", true);
+    for (GLsizei i = first; i < end;) {
+      GLsizei shared_end = run_end(i, end, false);
+      if (shared_end == i + 1) {
+        i = shared_end;
+        continue;
+      }
+      for (GLsizei j = i; j < shared_end; j = run_end(j, shared_end, true)) {
+        auto &d = draws[j];
+        shader.setInt("draw_base", j - first);
+        glDrawElementsInstancedBaseVertex(
+            mode, d.count, index_type,
+            (const void *)(size_t)(d.first_index * index_bytes),
+            run_end(j, shared_end, true) - j, d.base_vertex);
+        render_stats.draw_calls++;
+      }
+      i = shared_end;
+    }
+    shader.setBool("instanced", false);
+  }
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+// standard
+#include <cfloat>
+#include <cmath>
+
+// glm
+#include <glm/glm.hpp>
+
+// axis aligned bounding box; empty until a point is added
+struct AABB {
+  glm::vec3 min = glm::vec3(FLT_MAX);
+  glm::vec3 max = glm::vec3(-FLT_MAX);
+
+  void add(const glm::vec3 &p) {
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+  void add(const AABB &b) {
+    min = glm::min(min, b.min);
+    max = glm::max(max, b.max);
+  }
+  bool empty() const { return min.x > max.x; }
+  bool overlaps(const AABB &b) const {
+    return min.x <= b.max.x && b.min.x <= max.x && min.y <= b.max.y &&
+           b.min.y <= max.y && min.z <= b.max.z && b.min.z <= max.z;
+  }
+  glm::vec3 size() const { return max - min; }
+  float area() const {
+    if (empty()) return 0.0f;
+    glm::vec3 s = size();
+    return 2.0f * (s.x * s.y + s.y * s.z + s.z * s.x);
+  }
+  // largest absolute coordinate of any point in the box
+  float reach() const {
+    glm::vec3 m = glm::max(glm::abs(min), glm::abs(max));
+    return glm::max(m.x, glm::max(m.y, m.z));
+  }
+};
+
+// box around `box` moved by the affine transform `m` (Arvo)
+AABB transform_box(const AABB &box, const glm::mat4 &m) {
+  if (box.empty()) return box;
+  glm::vec3 center = (box.min + box.max) * 0.5f;
+  glm::vec3 half = (box.max - box.min) * 0.5f;
+  glm::vec3 c = glm::vec3(m * glm::vec4(center, 1.0f));
+  glm::vec3 e;
+  for (int i = 0; i < 3; i++)
+    e[i] = std::fabs(m[0][i]) * half.x + std::fabs(m[1][i]) * half.y +
+           std::fabs(m[2][i]) * half.z;
+  AABB out;
+  out.min = c - e;
+  out.max = c + e;
+  return out;
+}
+
+struct Sphere {
+  glm::vec3 center;
+  float radius;
+};
+
+// sphere through the corners of the box
+Sphere bounding_sphere(const AABB &box) {
+  return {(box.min + box.max) * 0.5f, glm::length(box.size()) * 0.5f};
+}
+
+// The six planes around the volume a projection * view matrix shows, as
+// (normal, distance) with the normals pointing in: p is inside when
+// dot(normal, p) + distance >= 0 for all of them.
+struct Frustum {
+  glm::vec4 planes[6];
+};
+
+// planes from the rows of the matrix (Gribb and Hartmann), normalized so
+// the distances are in world units
+Frustum frustum_planes(const glm::mat4 &m) {
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; i++)
+    rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+  Frustum f;
+  for (int i = 0; i < 3; i++) {
+    f.planes[2 * i] = rows[3] + rows[i];
+    f.planes[2 * i + 1] = rows[3] - rows[i];
+  }
+  for (auto &p : f.planes) p /= glm::length(glm::vec3(p));
+  return f;
+}
+
+// whether any of the sphere is inside the frustum
+bool sphere_in_frustum(const Frustum &f, const Sphere &s) {
+  for (auto &p : f.planes)
+    if (glm::dot(glm::vec3(p), s.center) + p.w < -s.radius) return false;
+  return true;
+}
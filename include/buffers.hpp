@@ -2,6 +2,7 @@
 
 // standard c++ headers
 #include <iostream>
+#include <utility>
 #include <vector>
 
 // glfw and glad
@@ -11,28 +12,70 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+// helpers
+#include "deletion.hpp"
+#include "glstate.hpp"
+#include "span.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+// GL objects below are move-only handles: moving hands the name over, and
+// only the last owner retires it
+
 class VBO {
  public:
-  GLuint ID;
-  VBO(std::vector<GLfloat> &vertices) {
+  GLuint ID = 0;
+  VBO(Span<const GLfloat> vertices) {
+    TraceScope trace("VBO upload", "gl");
     glGenBuffers(1, &ID);
     bind();
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float),
                  vertices.data(), GL_STATIC_DRAW);
+    render_stats.buffer_bytes += vertices.size() * sizeof(float);
+  }
+  // uninitialized storage, filled later with update()
+  VBO(GLsizeiptr size) {
+    glGenBuffers(1, &ID);
+    bind();
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STATIC_DRAW);
+  }
+  ~VBO() {
+    if (ID) deletion_queue.retire_buffer(ID);
+  }
+  VBO(VBO &&other) noexcept : ID(other.ID) { other.ID = 0; }
+  VBO &operator=(VBO &&other) noexcept {
+    std::swap(ID, other.ID);
+    return *this;
+  }
+  VBO(const VBO &) = delete;
+  VBO &operator=(const VBO &) = delete;
+  void bind() { gl_state.bind_buffer(GL_ARRAY_BUFFER, ID); }
+  void unbind() { gl_state.bind_buffer(GL_ARRAY_BUFFER, 0); }
+  void update(GLintptr offset, GLsizeiptr size, const void *data) {
+    TraceScope trace("VBO update", "gl");
+    bind();
+    glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+    render_stats.buffer_bytes += size;
   }
-  ~VBO() { glDeleteBuffers(1, &ID); }
-  void bind() { glBindBuffer(GL_ARRAY_BUFFER, ID); }
-  void unbind() { glBindBuffer(GL_ARRAY_BUFFER, 0); }
 };
 
 class VAO {
  public:
-  GLuint ID;
+  GLuint ID = 0;
   VAO() {
     glGenVertexArrays(1, &ID);
     bind();
   }
-  ~VAO() { glDeleteVertexArrays(1, &ID); }
+  ~VAO() {
+    if (ID) deletion_queue.retire_vertex_array(ID);
+  }
+  VAO(VAO &&other) noexcept : ID(other.ID) { other.ID = 0; }
+  VAO &operator=(VAO &&other) noexcept {
+    std::swap(ID, other.ID);
+    return *this;
+  }
+  VAO(const VAO &) = delete;
+  VAO &operator=(const VAO &) = delete;
   void add_attributes(VBO &vbo, GLuint index, GLint size, GLenum type,
                       GLboolean normalized, GLsizei stride,
                       const void *pointer) {
@@ -41,27 +84,53 @@ class VAO {
     glEnableVertexAttribArray(index);
     vbo.unbind();
   }
-  void bind() { glBindVertexArray(ID); }
-  void unbind() { glBindVertexArray(0); }
+  void bind() { gl_state.bind_vertex_array(ID); }
+  void unbind() { gl_state.bind_vertex_array(0); }
 };
 
 class EBO {
  public:
-  GLuint ID;
-  EBO(std::vector<GLuint> &indices) {
+  GLuint ID = 0;
+  EBO(Span<const GLuint> indices) {
+    TraceScope trace("EBO upload", "gl");
     glGenBuffers(1, &ID);
     bind();
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
                  indices.data(), GL_STATIC_DRAW);
+    render_stats.buffer_bytes += indices.size() * sizeof(unsigned int);
+  }
+  // uninitialized storage, filled later with update(). Binds to the current
+  // vertex array.
+  EBO(GLsizeiptr size) {
+    glGenBuffers(1, &ID);
+    bind();
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, NULL, GL_STATIC_DRAW);
+  }
+  ~EBO() {
+    if (ID) deletion_queue.retire_buffer(ID);
+  }
+  EBO(EBO &&other) noexcept : ID(other.ID) { other.ID = 0; }
+  EBO &operator=(EBO &&other) noexcept {
+    std::swap(ID, other.ID);
+    return *this;
+  }
+  EBO(const EBO &) = delete;
+  EBO &operator=(const EBO &) = delete;
+  void bind() { gl_state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ID); }
+  void unbind() { gl_state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0); }
+  // the element binding belongs to the vertex array, so bind the one that
+  // holds this buffer first
+  void update(GLintptr offset, GLsizeiptr size, const void *data) {
+    TraceScope trace("EBO update", "gl");
+    bind();
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, size, data);
+    render_stats.buffer_bytes += size;
   }
-  ~EBO() { glDeleteBuffers(1, &ID); }
-  void bind() { glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID); }
-  void unbind() { glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); }
 };
 
 class Texture {
  public:
-  GLuint ID;
+  GLuint ID = 0;
   Texture(std::string path) {
     glGenTextures(1, &ID);
     bind();
@@ -73,9 +142,13 @@ class Texture {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     // load image, create texture and generate mipmaps
     int width, height, nrChannels;
-    unsigned char *data =
-        stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
+    unsigned char *data;
+    {
+      TraceScope trace("stbi_load", "texture");
+      data = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
+    }
     if (data) {
+      TraceScope trace("texture upload", "gl");
       GLenum format;
       if (nrChannels == 1)
         format = GL_RED;
@@ -92,7 +165,16 @@ class Texture {
     stbi_image_free(data);
     unbind();
   }
-  ~Texture() { glDeleteTextures(1, &ID); }
-  void bind() { glBindTexture(GL_TEXTURE_2D, ID); }
-  void unbind() { glBindTexture(GL_TEXTURE_2D, 0); }
+  ~Texture() {
+    if (ID) deletion_queue.retire_texture(ID);
+  }
+  Texture(Texture &&other) noexcept : ID(other.ID) { other.ID = 0; }
+  Texture &operator=(Texture &&other) noexcept {
+    std::swap(ID, other.ID);
+    return *this;
+  }
+  Texture(const Texture &) = delete;
+  Texture &operator=(const Texture &) = delete;
+  void bind() { gl_state.bind_texture(GL_TEXTURE_2D, ID); }
+  void unbind() { gl_state.bind_texture(GL_TEXTURE_2D, 0); }
 };
\ No newline at end of file
@@ -0,0 +1,377 @@
+#pragma once
+
+// standard
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+// glm
+#include <glm/glm.hpp>
+
+// helpers
+#include "bounds.hpp"
+#include "pool.hpp"
+#include "trace.hpp"
+
+// leaves hold up to one sphere culler step of items
+const int BVH_LEAF_SIZE = 8;
+// centroid bins tried per split
+const int BVH_BINS = 16;
+// refits that grow the summed node area past this factor of the built tree
+// make it stale
+const float BVH_REBUILD_RATIO = 1.5f;
+
+// Bounding volume hierarchy over item boxes, e.g. the world bounds of the
+// shapes. Splits minimize the surface area heuristic over BVH_BINS centroid
+// bins; the top of the tree is split on the calling thread and the subtrees
+// below it are built on the thread pool.
+//
+// Moved items are refit in place: update() marks the path to the root and
+// refit() recomputes only the marked nodes. Once refits have degraded the
+// tree, stale() tells the owner to build it again.
+class BVH {
+ public:
+  struct Node {
+    AABB box;
+    int first;  // first item of a leaf in `order`, or the left child, with
+                // the right child after it
+    int count;  // items of a leaf, 0 for inner nodes
+  };
+  // children always come after their parent
+  std::vector<Node> nodes;
+  // items by leaf
+  std::vector<int> order;
+
+  // build over items 0 .. boxes.size() - 1; items with empty boxes are left
+  // out
+  void build(const std::vector<AABB> &item_boxes) {
+    TraceScope trace("bvh build", "geometry");
+    boxes = item_boxes;
+    int n = boxes.size();
+    centroids.resize(n);
+    order.clear();
+    for (int i = 0; i < n; i++) {
+      centroids[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+      if (!boxes[i].empty()) order.push_back(i);
+    }
+    nodes.clear();
+    leaf_of.assign(n, -1);
+    dirty_nodes.clear();
+    needs_build = false;
+    if (order.empty()) {
+      parent.clear();
+      dirty.clear();
+      built_area = area_sum = 0.0f;
+      return;
+    }
+
+    // split the top serially until there are enough subtrees to share out
+    struct Task {
+      int node, begin, end;
+    };
+    int m = order.size();
+    int grain = std::max(m / (4 * thread_pool.size()), 1024);
+    std::vector<Task> top = {{0, 0, m}}, tasks;
+    nodes.push_back(Node());
+    while (!top.empty()) {
+      Task t = top.back();
+      top.pop_back();
+      if (t.end - t.begin <= grain) {
+        tasks.push_back(t);
+        continue;
+      }
+      int mid = split(nodes, t.node, t.begin, t.end);
+      if (mid < 0) continue;
+      int left = nodes[t.node].first;
+      top.push_back({left, t.begin, mid});
+      top.push_back({left + 1, mid, t.end});
+    }
+
+    // build the subtrees in parallel, each into its own nodes, then append
+    // them with their child indices moved
+    std::vector<std::vector<Node>> subtrees(tasks.size());
+    thread_pool.parallel_for(tasks.size(), 1, [&](size_t first, size_t last) {
+      for (size_t k = first; k < last; k++)
+        build_subtree(subtrees[k], tasks[k].begin, tasks[k].end);
+    });
+    for (size_t k = 0; k < tasks.size(); k++) {
+      std::vector<Node> &sub = subtrees[k];
+      int offset = int(nodes.size()) - 1;
+      for (auto &node : sub)
+        if (node.count == 0) node.first += offset;
+      nodes[tasks[k].node] = sub[0];
+      nodes.insert(nodes.end(), sub.begin() + 1, sub.end());
+    }
+
+    parent.assign(nodes.size(), -1);
+    dirty.assign(nodes.size(), 0);
+    area_sum = 0.0f;
+    for (int i = 0; i < int(nodes.size()); i++) {
+      const Node &node = nodes[i];
+      area_sum += node.box.area();
+      if (node.count == 0) {
+        parent[node.first] = parent[node.first + 1] = i;
+      } else {
+        for (int j = node.first; j < node.first + node.count; j++)
+          leaf_of[order[j]] = i;
+      }
+    }
+    built_area = area_sum;
+  }
+
+  // the item moved to `box`; takes effect on refit()
+  void update(int item, const AABB &box) {
+    boxes[item] = box;
+    int leaf = leaf_of[item];
+    if (leaf < 0 || box.empty()) {
+      // items joining or leaving the tree need a build
+      needs_build = true;
+      return;
+    }
+    for (int n = leaf; n >= 0 && !dirty[n]; n = parent[n]) {
+      dirty[n] = 1;
+      dirty_nodes.push_back(n);
+    }
+  }
+
+  // recompute the boxes of the nodes above updated items, children first
+  void refit() {
+    if (dirty_nodes.empty()) return;
+    std::sort(dirty_nodes.begin(), dirty_nodes.end(), std::greater<int>());
+    for (int i : dirty_nodes) {
+      Node &node = nodes[i];
+      float before = node.box.area();
+      node.box = AABB();
+      if (node.count == 0) {
+        node.box.add(nodes[node.first].box);
+        node.box.add(nodes[node.first + 1].box);
+      } else {
+        for (int j = node.first; j < node.first + node.count; j++)
+          node.box.add(boxes[order[j]]);
+      }
+      area_sum += node.box.area() - before;
+      dirty[i] = 0;
+    }
+    dirty_nodes.clear();
+    if (area_sum > BVH_REBUILD_RATIO * built_area) needs_build = true;
+  }
+
+  // whether items joined or left, or refits degraded the tree
+  bool stale() const { return needs_build; }
+
+  // Calls visit(items, count, inside) for the leaves whose boxes reach into
+  // the frustum; inside is true when the whole leaf is in it.
+  template <typename Visit>
+  void frustum(const Frustum &f, Visit &&visit) const {
+    if (nodes.empty()) return;
+    // nodes to visit, negated once known to be inside
+    stack.assign(1, 0);
+    while (!stack.empty()) {
+      int top = stack.back();
+      stack.pop_back();
+      bool inside = top < 0;
+      const Node &node = nodes[inside ? -top : top];
+      if (!inside) {
+        int test = classify(node.box, f);
+        if (test < 0) continue;
+        inside = test > 0;
+      }
+      if (node.count > 0) {
+        visit(&order[node.first], node.count, inside);
+        continue;
+      }
+      for (int c = 0; c < 2; c++)
+        stack.push_back(inside ? -(node.first + c) : node.first + c);
+    }
+  }
+
+  // calls visit(item) for every item whose box overlaps `box`
+  template <typename Visit>
+  void overlap(const AABB &box, Visit &&visit) const {
+    if (nodes.empty()) return;
+    stack.assign(1, 0);
+    while (!stack.empty()) {
+      const Node &node = nodes[stack.back()];
+      stack.pop_back();
+      if (!node.box.overlaps(box)) continue;
+      if (node.count > 0) {
+        for (int j = node.first; j < node.first + node.count; j++)
+          if (boxes[order[j]].overlaps(box)) visit(order[j]);
+        continue;
+      }
+      stack.push_back(node.first);
+      stack.push_back(node.first + 1);
+    }
+  }
+
+  // the item whose box the ray origin + t dir enters first within
+  // [0, max_t], or -1, among those accept(item) is true for; `t` gets the
+  // distance
+  int raycast(const glm::vec3 &origin, const glm::vec3 &dir, float &t,
+              float max_t = FLT_MAX) const {
+    return raycast(origin, dir, t, [](int) { return true; }, max_t);
+  }
+  template <typename Accept>
+  int raycast(const glm::vec3 &origin, const glm::vec3 &dir, float &t,
+              Accept &&accept, float max_t = FLT_MAX) const {
+    int hit = -1;
+    t = max_t;
+    if (nodes.empty()) return hit;
+    glm::vec3 inv = glm::vec3(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+    stack.assign(1, 0);
+    while (!stack.empty()) {
+      const Node &node = nodes[stack.back()];
+      stack.pop_back();
+      if (slab(node.box, origin, inv) >= t) continue;
+      if (node.count > 0) {
+        for (int j = node.first; j < node.first + node.count; j++) {
+          float d = slab(boxes[order[j]], origin, inv);
+          if (d < t && accept(order[j])) t = d, hit = order[j];
+        }
+        continue;
+      }
+      // nearer child on top of the stack
+      int a = node.first, b = node.first + 1;
+      float da = slab(nodes[a].box, origin, inv);
+      float db = slab(nodes[b].box, origin, inv);
+      if (da < db) std::swap(a, b);
+      stack.push_back(a);
+      stack.push_back(b);
+    }
+    return hit;
+  }
+
+ private:
+  std::vector<AABB> boxes;
+  std::vector<glm::vec3> centroids;
+  std::vector<int> parent;
+  std::vector<int> leaf_of;  // by item, -1 when not in the tree
+  std::vector<char> dirty;
+  std::vector<int> dirty_nodes;
+  float built_area = 0.0f, area_sum = 0.0f;
+  bool needs_build = false;
+  // traversal scratch, which makes queries single threaded
+  mutable std::vector<int> stack;
+
+  // -1 outside the frustum, 1 inside, 0 crossing it
+  static int classify(const AABB &box, const Frustum &f) {
+    int result = 1;
+    for (const glm::vec4 &p : f.planes) {
+      glm::vec3 n(p);
+      // the corners furthest along and against the normal
+      glm::vec3 ahead(n.x > 0 ? box.max.x : box.min.x,
+                      n.y > 0 ? box.max.y : box.min.y,
+                      n.z > 0 ? box.max.z : box.min.z);
+      glm::vec3 behind(n.x > 0 ? box.min.x : box.max.x,
+                       n.y > 0 ? box.min.y : box.max.y,
+                       n.z > 0 ? box.min.z : box.max.z);
+      if (glm::dot(n, ahead) + p.w < 0.0f) return -1;
+      if (glm::dot(n, behind) + p.w < 0.0f) result = 0;
+    }
+    return result;
+  }
+
+  // distance along the ray to the box, FLT_MAX when it misses
+  static float slab(const AABB &box, const glm::vec3 &origin,
+                    const glm::vec3 &inv) {
+    float enter = 0.0f, leave = FLT_MAX;
+    for (int i = 0; i < 3; i++) {
+      float a = (box.min[i] - origin[i]) * inv[i];
+      float b = (box.max[i] - origin[i]) * inv[i];
+      if (a > b) std::swap(a, b);
+      enter = std::max(enter, a);
+      leave = std::min(leave, b);
+    }
+    return enter <= leave ? enter : FLT_MAX;
+  }
+
+  void build_subtree(std::vector<Node> &out, int begin, int end) {
+    struct Range {
+      int node, begin, end;
+    };
+    out.push_back(Node());
+    std::vector<Range> stack = {{0, begin, end}};
+    while (!stack.empty()) {
+      Range r = stack.back();
+      stack.pop_back();
+      int mid = split(out, r.node, r.begin, r.end);
+      if (mid < 0) continue;
+      int left = out[r.node].first;
+      stack.push_back({left, r.begin, mid});
+      stack.push_back({left + 1, mid, r.end});
+    }
+  }
+
+  // Bound order[begin, end) with node `i` of `out`. Small ranges become
+  // leaves and return -1; larger ones get two children, appended to `out`,
+  // and return where the items were partitioned between them.
+  int split(std::vector<Node> &out, int i, int begin, int end) {
+    AABB box, centers;
+    for (int j = begin; j < end; j++) {
+      box.add(boxes[order[j]]);
+      centers.add(centroids[order[j]]);
+    }
+    out[i].box = box;
+    int count = end - begin;
+    if (count <= BVH_LEAF_SIZE) {
+      out[i].first = begin;
+      out[i].count = count;
+      return -1;
+    }
+
+    glm::vec3 extent = centers.size();
+    int axis = extent.x > extent.y ? 0 : 1;
+    if (extent.z > extent[axis]) axis = 2;
+    int mid = (begin + end) / 2;
+    if (extent[axis] > 0.0f) {
+      // bin the centroids, then sweep the planes between bins from both
+      // sides
+      AABB bin_box[BVH_BINS];
+      int bin_count[BVH_BINS] = {0};
+      float lo = centers.min[axis];
+      float scale = BVH_BINS / extent[axis];
+      auto bin = [&](int item) {
+        int b = int((centroids[item][axis] - lo) * scale);
+        return std::min(b, BVH_BINS - 1);
+      };
+      for (int j = begin; j < end; j++) {
+        int b = bin(order[j]);
+        bin_count[b]++;
+        bin_box[b].add(boxes[order[j]]);
+      }
+      float right_area[BVH_BINS];
+      AABB acc;
+      int right_count[BVH_BINS], n = 0;
+      for (int b = BVH_BINS - 1; b > 0; b--) {
+        acc.add(bin_box[b]);
+        n += bin_count[b];
+        right_area[b] = acc.area();
+        right_count[b] = n;
+      }
+      acc = AABB();
+      n = 0;
+      float best = FLT_MAX;
+      int best_bin = -1;
+      for (int b = 1; b < BVH_BINS; b++) {
+        acc.add(bin_box[b - 1]);
+        n += bin_count[b - 1];
+        if (n == 0 || right_count[b] == 0) continue;
+        float cost = acc.area() * n + right_area[b] * right_count[b];
+        if (cost < best) best = cost, best_bin = b;
+      }
+      if (best_bin > 0)
+        mid = std::partition(order.begin() + begin, order.begin() + end,
+                             [&](int item) { return bin(item) < best_bin; }) -
+              order.begin();
+    }
+
+    int left = out.size();
+    out[i].first = left;
+    out[i].count = 0;
+    out.push_back(Node());
+    out.push_back(Node());
+    return mid;
+  }
+};
@@ -5,6 +5,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 // helpers
+#include "bounds.hpp"
 #include "utils.hpp"
 
 // Defines several possible options for camera movement. Used as abstraction to
@@ -16,6 +17,8 @@ const float YAW = -90.0f;
 const float PITCH = 0.0f;
 const float SPEED = 2.5f;
 const float ZOOM = 45.0f;
+const float Z_NEAR = 0.1f;
+const float Z_FAR = 100.0f;
 
 // An abstract camera class that processes input and calculates the
 // corresponding Euler Angles, Vectors and Matrices for use in OpenGL
@@ -40,6 +43,9 @@ class Camera {
 
   float aspect_ratio = 1.0f;
 
+  // planes of the view volume, see update_frustum()
+  Frustum frustum;
+
   // constructor with vectors
   Camera(glm::vec3 position = glm::vec3(0), glm::vec3 up = glm::vec3(0, 1, 0),
          float yaw = YAW, float pitch = PITCH)
@@ -67,6 +73,15 @@ class Camera {
     return glm::lookAt(Position, Position + Front, Up);
   }
 
+  glm::mat4 GetProjectionMatrix() {
+    return glm::perspective(glm::radians(Zoom), aspect_ratio, Z_NEAR, Z_FAR);
+  }
+
+  // extract the frustum planes; once per frame, after the camera moved
+  void update_frustum() {
+    frustum = frustum_planes(GetProjectionMatrix() * GetViewMatrix());
+  }
+
   // processes input received from any keyboard-like input system. Accepts input
   // parameter in the form of camera defined ENUM (to abstract it from windowing
   // systems)
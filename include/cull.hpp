@@ -0,0 +1,133 @@
+#pragma once
+
+// standard
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// simd
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// glm
+#include <glm/glm.hpp>
+
+// helpers
+#include "bounds.hpp"
+
+// spheres tested per kernel step; the arrays are padded to a multiple
+const int CULL_LANES = 8;
+
+// Writes 1 to visible[i] for each sphere at least partly inside the
+// frustum, for `count` spheres rounded up to CULL_LANES. Centers and radii
+// are separate arrays, so each plane test is a few vector multiply-adds
+// over as many spheres as the vectors hold.
+void cull_spheres_kernel(const Frustum &f, const float *x, const float *y,
+                         const float *z, const float *r, size_t count,
+                         uint8_t *visible) {
+#if defined(__AVX__)
+#define CULL_SET(v) _mm256_set1_ps(v)
+#define CULL_MUL _mm256_mul_ps
+#define CULL_ADD _mm256_add_ps
+  const int width = 8;
+  typedef __m256 lane;
+  auto load = [](const float *p) { return _mm256_loadu_ps(p); };
+  // bit i of the result is set when lane i is not below zero
+  auto inside = [](lane d) {
+    return _mm256_movemask_ps(
+        _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+  };
+#elif defined(__SSE2__)
+#define CULL_SET(v) _mm_set1_ps(v)
+#define CULL_MUL _mm_mul_ps
+#define CULL_ADD _mm_add_ps
+  const int width = 4;
+  typedef __m128 lane;
+  auto load = [](const float *p) { return _mm_loadu_ps(p); };
+  auto inside = [](lane d) {
+    return _mm_movemask_ps(_mm_cmpge_ps(d, _mm_setzero_ps()));
+  };
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define CULL_SET(v) vdupq_n_f32(v)
+#define CULL_MUL vmulq_f32
+#define CULL_ADD vaddq_f32
+  const int width = 4;
+  typedef float32x4_t lane;
+  auto load = [](const float *p) { return vld1q_f32(p); };
+  auto inside = [](lane d) {
+    const uint32_t bits[4] = {1, 2, 4, 8};
+    uint32x4_t ge = vcgeq_f32(d, vdupq_n_f32(0.0f));
+    return int(vaddvq_u32(vandq_u32(ge, vld1q_u32(bits))));
+  };
+#else
+#define CULL_SET(v) (v)
+#define CULL_MUL(a, b) ((a) * (b))
+#define CULL_ADD(a, b) ((a) + (b))
+  const int width = 1;
+  typedef float lane;
+  auto load = [](const float *p) { return *p; };
+  auto inside = [](lane d) { return int(d >= 0.0f); };
+#endif
+  const int all = (1 << width) - 1;
+  for (size_t i = 0; i < count; i += width) {
+    lane px = load(x + i), py = load(y + i), pz = load(z + i),
+         pr = load(r + i);
+    int mask = all;
+    for (int p = 0; p < 6 && mask; p++) {
+      const glm::vec4 &plane = f.planes[p];
+      // signed distance of the center, pushed out by the radius
+      lane d = CULL_ADD(CULL_MUL(px, CULL_SET(plane.x)),
+                        CULL_MUL(py, CULL_SET(plane.y)));
+      d = CULL_ADD(d, CULL_MUL(pz, CULL_SET(plane.z)));
+      d = CULL_ADD(d, CULL_ADD(pr, CULL_SET(plane.w)));
+      mask &= inside(d);
+    }
+    for (int l = 0; l < width; l++) visible[i + l] = (mask >> l) & 1;
+  }
+#undef CULL_SET
+#undef CULL_MUL
+#undef CULL_ADD
+}
+
+// Bounding spheres gathered for one frustum test, stored as structure of
+// arrays for the kernel. The arrays keep their storage between frames.
+class SphereCuller {
+ public:
+  void clear() { count = 0; }
+
+  size_t size() const { return count; }
+
+  void add(const Sphere &s) {
+    if (count == x.size()) grow();
+    x[count] = s.center.x;
+    y[count] = s.center.y;
+    z[count] = s.center.z;
+    r[count] = s.radius;
+    count++;
+  }
+
+  void cull(const Frustum &f) {
+    // the padding past count holds stale spheres; their results are unused
+    cull_spheres_kernel(f, x.data(), y.data(), z.data(), r.data(), count,
+                        inside.data());
+  }
+
+  bool visible(size_t i) const { return inside[i]; }
+
+ private:
+  size_t count = 0;
+  std::vector<float> x, y, z, r;
+  std::vector<uint8_t> inside;
+
+  void grow() {
+    size_t capacity = std::max<size_t>(2 * x.size(), CULL_LANES);
+    for (auto v : {&x, &y, &z, &r}) v->resize(capacity);
+    inside.resize(capacity);
+  }
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+// standard
+#include <deque>
+#include <vector>
+
+// glad
+#include <glad/glad.h>
+
+// helpers
+#include "allocator.hpp"
+#include "glstate.hpp"
+#include "trace.hpp"
+
+// frames a retired object lives on before it may be deleted; its fence must
+// also have signalled by then
+const int DELETION_FRAMES = 3;
+
+// GL objects and buffer ranges retired in one frame, freed together once the
+// fence placed after that frame has signalled
+struct RetiredBatch {
+  GLsync fence = 0;
+  int frame = 0;
+  std::vector<GLuint> buffers, vertex_arrays, textures, programs;
+  struct Range {
+    RangeAllocator *allocator;
+    GLuint offset, size;
+  };
+  std::vector<Range> ranges;
+
+  bool empty() const {
+    return buffers.empty() && vertex_arrays.empty() && textures.empty() &&
+           programs.empty() && ranges.empty();
+  }
+};
+
+// Defers deleting GL objects until the GPU is certainly done with them, so
+// destroying meshes in the middle of a frame neither stalls on work still in
+// flight nor frees ranges that are about to be overwritten. Deletes of one
+// kind go out as a single glDelete* call.
+class DeletionQueue {
+ public:
+  void retire_buffer(GLuint id) { pending.buffers.push_back(id); }
+  void retire_vertex_array(GLuint id) { pending.vertex_arrays.push_back(id); }
+  void retire_texture(GLuint id) { pending.textures.push_back(id); }
+  void retire_program(GLuint id) { pending.programs.push_back(id); }
+  void retire_range(RangeAllocator *allocator, GLuint offset,
+                    GLuint size) {
+    pending.ranges.push_back({allocator, offset, size});
+  }
+
+  // free the batches whose fence has signalled, without waiting
+  void collect() {
+    while (!retiring.empty()) {
+      RetiredBatch &b = retiring.front();
+      if (frame - b.frame < DELETION_FRAMES) break;
+      GLenum status = glClientWaitSync(b.fence, 0, 0);
+      if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        break;
+      free(b);
+      retiring.pop_front();
+    }
+  }
+
+  // fence what was retired this frame
+  void end_frame() {
+    if (!pending.empty()) {
+      pending.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      pending.frame = frame;
+      retiring.push_back(std::move(pending));
+      pending = RetiredBatch();
+    }
+    frame++;
+  }
+
+  // free everything now, e.g. before the owners of retired ranges go away
+  void flush() {
+    for (auto &b : retiring) free(b);
+    retiring.clear();
+    free(pending);
+    pending = RetiredBatch();
+  }
+
+ private:
+  RetiredBatch pending;
+  std::deque<RetiredBatch> retiring;
+  int frame = 0;
+
+  void free(RetiredBatch &b) {
+    TraceScope trace("deferred delete", "gl");
+    if (b.fence) glDeleteSync(b.fence);
+    if (!b.buffers.empty()) {
+      glDeleteBuffers(b.buffers.size(), b.buffers.data());
+      for (auto id : b.buffers) gl_state.forget_buffer(id);
+    }
+    if (!b.vertex_arrays.empty()) {
+      glDeleteVertexArrays(b.vertex_arrays.size(), b.vertex_arrays.data());
+      for (auto id : b.vertex_arrays) gl_state.forget_vertex_array(id);
+    }
+    if (!b.textures.empty()) {
+      glDeleteTextures(b.textures.size(), b.textures.data());
+      for (auto id : b.textures) gl_state.forget_texture(id);
+    }
+    for (auto id : b.programs) {
+      glDeleteProgram(id);
+      gl_state.forget_program(id);
+    }
+    for (auto &r : b.ranges) r.allocator->release(r.offset, r.size);
+  }
+};
+
+DeletionQueue deletion_queue;
@@ -5,12 +5,31 @@
 #include <glad/glad.h>
 #define STB_IMAGE_IMPLEMENTATION
 
+// standard
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
 // helpers
+#include "arena.hpp"
+#include "batch.hpp"
+#include "bvh.hpp"
 #include "buffers.hpp"
 #include "camera.hpp"
+#include "cull.hpp"
+#include "deletion.hpp"
+#include "glstate.hpp"
+#include "gpucull.hpp"
+#include "profiler.hpp"
+#include "queue.hpp"
+#include "resources.hpp"
 #include "shader.hpp"
 #include "shape.hpp"
+#include "stats.hpp"
+#include "stream.hpp"
 #include "text.hpp"
+#include "trace.hpp"
 #include "utils.hpp"
 
 // mouse
@@ -83,17 +102,16 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action,
 
     // toggle wireframe mode (useful for debugging)
     if (key == GLFW_KEY_COMMA)
-      glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+      gl_state.polygon_mode(GL_FILL);
     else if (key == GLFW_KEY_PERIOD)
-      glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+      gl_state.polygon_mode(GL_LINE);
   }
 }
 
 // glfw: initialize and configure
-void glfw_ready() {
-  glfwInit();
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+void glfw_ready(int major, int minor) {
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
@@ -107,15 +125,25 @@ void glad_ready() {
   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
     die("Failed to initialize GLAD");
 
-  glEnable(GL_DEPTH_TEST);
+  gl_state.invalidate();
+  gl_state.set(GL_DEPTH_TEST, true);
 }
 
-GLFWwindow *make_window(int width, int height, std::string title) {
-  glfw_ready();
-
-  // glfw window creation
-  GLFWwindow *window =
-      glfwCreateWindow(width, height, title.c_str(), NULL, NULL);
+// hidden windows still get a context, e.g. for tests
+GLFWwindow *make_window(int width, int height, std::string title,
+                        bool visible = true) {
+  glfwInit();
+  glfwWindowHint(GLFW_VISIBLE, visible);
+
+  // glfw window creation; prefer the newest core context for multi-draw
+  // indirect (4.3) and persistent mapping (4.4), down to 3.3 core
+  const int versions[][2] = {{4, 6}, {4, 4}, {4, 3}, {3, 3}};
+  GLFWwindow *window = NULL;
+  for (auto &v : versions) {
+    glfw_ready(v[0], v[1]);
+    window = glfwCreateWindow(width, height, title.c_str(), NULL, NULL);
+    if (window) break;
+  }
   if (!window) {
     glfwTerminate();
     die("Failed to create GLFW window");
@@ -134,6 +162,9 @@ void clear_screen(glm::vec3 color) {
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
+// seconds a key is held before on_keyrepeat starts repeating
+const double KEY_REPEAT_DELAY = 0.3;
+
 class Game {
  public:
   std::string title;
@@ -141,14 +172,45 @@ class Game {
   GLFWwindow *window;
   glm::vec3 bg_color = rgb(0.1f, 0.1f, 0.1f);
   std::map<std::string, Font> fonts;
-  std::vector<Mesh *> shapes;
+  std::deque<Mesh> shapes;  // a deque keeps mesh addresses stable
+  RenderQueue<Mesh> queue;
+  DrawBatcher batcher;
+  // instances culled and drawn by a compute pass, after the shapes
+  GpuCuller gpu_culler;
+  // world bounds of the shapes by index in `shapes`, for culling and
+  // queries; see update_bvh()
+  BVH bvh;
+  std::vector<AABB> world_boxes;
+  // the tree's log of moved slots in the transform store, and the shape
+  // index of each slot, -1 for slots of other meshes
+  int bvh_log;
+  std::vector<int> shape_of;
+  // shapes without bounds, left out of the tree and drawn untested
+  std::vector<int> unbounded;
+  // bounded shapes waiting for the frustum test, and their spheres
+  std::vector<Mesh *> cull_candidates;
+  SphereCuller culler;
 
   // camera
   Camera camera;
 
-  Game(std::string title, int width, int height)
+  // cpu and gpu frame timings
+  Profiler profiler;
+
+  // render work counters, per frame
+  StatsRecorder stats;
+
+  // keys held down for on_keyrepeat, with the time they went down
+  std::map<int, double> held;
+
+  Game(std::string title, int width, int height, bool visible = true)
       : title(title), width(width), height(height) {
-    window = make_window(width, height, title);
+    tracer.name_thread("main");
+    bvh_log = transforms.watch();
+    window = make_window(width, height, title, visible);
+    stream.init();
+    batcher.init();
+    gpu_culler.init();
     load_font("fonts/Antonio-Bold.ttf", "antonio");  // default font
     camera.Position = glm::vec3(0.0f, 0.0f, 3.0f);
     camera.aspect_ratio = (float)width / (float)height;
@@ -159,6 +221,15 @@ class Game {
   ~Game() {
     delete_fonts();
     delete_shapes();
+    // retired arena ranges point into the pages, so free them first
+    deletion_queue.flush();
+    arena.clear();
+    resources.clear();
+    deletion_queue.flush();
+    batcher.destroy();
+    gpu_culler.destroy();
+    stream.destroy();
+    profiler.destroy();
     glfwDestroyWindow(window);
     glfwTerminate();
   }
@@ -166,15 +237,14 @@ class Game {
   void delete_fonts() {
     for (auto &pair : fonts) {
       Font &f = pair.second;
-      glDeleteTextures(1, &f.glyphs['A'].TextureID);
-      glDeleteVertexArrays(1, &f.VAO);
-      glDeleteBuffers(1, &f.VBO);
+      deletion_queue.retire_texture(f.glyphs['A'].TextureID);
+      deletion_queue.retire_vertex_array(f.VAO);
     }
   }
 
   void delete_shapes() {
-    for (auto &shape : shapes) delete shape;
     shapes.clear();
+    world_boxes.clear();
   }
 
   void load_font(std::string font_name, std::string alias) {
@@ -201,20 +271,47 @@ class Game {
   void loop(void processInput(Game &), void update(Game &),
             void render(Game &)) {
     while (!glfwWindowShouldClose(window)) {
+      profiler.begin_frame();
+      stats.begin_frame();
+      stream.begin_frame();
+      deletion_queue.collect();
       camera.new_frame();
 
-      processInput(*this);
-      kbd_move_camera();
+      {
+        ProfileZone zone(profiler, "update");
+        processInput(*this);
+        kbd_move_camera();
 
-      for (auto &shape : shapes) basic_shape_move(shape);
+        basic_shapes_move();
+        transforms.update();
 
-      update(*this);
+        update(*this);
+      }
 
-      clear_screen(bg_color);
+      {
+        ProfilePass pass(profiler, "clear");
+        clear_screen(bg_color);
+      }
 
-      for (auto &shape : shapes) shape->render(camera);
+      {
+        ProfilePass pass(profiler, "meshes");
+        render_shapes();
+      }
 
-      render(*this);
+      if (gpu_culler.enabled) {
+        ProfilePass pass(profiler, "gpu cull");
+        gpu_culler.render(camera, height);
+      }
+
+      {
+        ProfilePass pass(profiler, "text");
+        render(*this);
+      }
+
+      stream.end_frame();
+      deletion_queue.end_frame();
+      stats.end_frame();
+      profiler.end_frame();
 
       // glfw: swap buffers and poll IO events
       glfwSwapBuffers(window);
@@ -222,6 +319,123 @@ class Game {
     }
   }
 
+  // Refit the shapes the transform store logged as moved, turned or
+  // reshaped since the last call. The tree is built again, and the
+  // unbounded list gathered, when shapes were added, a shape gained or lost
+  // its bounds or the refits have degraded the tree.
+  void update_bvh() {
+    bool rebuild = world_boxes.size() != shapes.size() || bvh.stale();
+    if (!rebuild) {
+      for (TransformHandle h : transforms.moved(bvh_log)) refit_shape(h);
+      for (TransformHandle h : transforms.reshaped) refit_shape(h);
+      bvh.refit();
+    }
+    transforms.clear_moved(bvh_log);
+    transforms.clear_reshaped();
+    if (rebuild || bvh.stale()) {
+      world_boxes.resize(shapes.size());
+      shape_of.assign(transforms.size(), -1);
+      unbounded.clear();
+      for (size_t i = 0; i < shapes.size(); i++) {
+        world_boxes[i] = shapes[i].world_box();
+        shape_of[shapes[i].transform] = i;
+        if (!shapes[i].bounded) unbounded.push_back(i);
+      }
+      bvh.build(world_boxes);
+    }
+  }
+
+  void refit_shape(TransformHandle h) {
+    int i = h < shape_of.size() ? shape_of[h] : -1;
+    if (i >= 0) bvh.update(i, shapes[i].world_box());
+  }
+
+  // the visible shape whose bounds the ray from `origin` along `dir` meets
+  // first, or NULL
+  Mesh *pick(const glm::vec3 &origin, const glm::vec3 &dir) {
+    update_bvh();
+    float t;
+    int hit = bvh.raycast(origin, dir, t,
+                          [&](int i) { return shapes[i].visible(); });
+    return hit >= 0 ? &shapes[hit] : NULL;
+  }
+
+  // calls visit(mesh) for the visible shapes whose bounds overlap `box`
+  template <typename Visit>
+  void shapes_in(const AABB &box, Visit &&visit) {
+    update_bvh();
+    bvh.overlap(box, [&](int i) {
+      if (shapes[i].visible()) visit(shapes[i]);
+    });
+  }
+
+  // draw the visible shapes sorted by pipeline state, then front to back.
+  // Shapes with bounds outside the frustum are dropped before any GL call,
+  // and runs of shapes sharing program, texture and vertex array go out as
+  // one multi-draw.
+  void render_shapes() {
+    glm::mat4 view = camera.GetViewMatrix();
+    camera.update_frustum();
+    queue.clear();
+    cull_candidates.clear();
+    culler.clear();
+    update_bvh();
+    for (int i : unbounded) {
+      Mesh &shape = shapes[i];
+      if (shape.visible()) queue.submit(shape.sort_key(view), &shape);
+    }
+
+    // leaves wholly inside the frustum go straight to the queue, the shapes
+    // of leaves on its edge get the sphere test
+    size_t reached = 0, drawn = 0;
+    bvh.frustum(camera.frustum, [&](const int *items, int count,
+                                    bool inside) {
+      for (int k = 0; k < count; k++) {
+        Mesh *shape = &shapes[items[k]];
+        if (!shape->visible()) continue;
+        reached++;
+        if (inside) {
+          queue.submit(shape->sort_key(view), shape);
+          drawn++;
+        } else {
+          cull_candidates.push_back(shape);
+          culler.add(shape->world_sphere());
+        }
+      }
+    });
+    culler.cull(camera.frustum);
+    for (size_t i = 0; i < cull_candidates.size(); i++) {
+      if (!culler.visible(i)) continue;
+      queue.submit(cull_candidates[i]->sort_key(view), cull_candidates[i]);
+      drawn++;
+    }
+    render_stats.shapes_tested += reached;
+    render_stats.shapes_culled += reached - drawn;
+    queue.sort();
+
+    auto &items = queue.items;
+    for (size_t i = 0; i < items.size();) {
+      Mesh *first = items[i].item;
+      size_t end = i + 1;
+      while (end < items.size() && first->batches_with(*items[end].item))
+        end++;
+
+      if (end - i == 1) {
+        first->draw(camera);
+      } else {
+        first->bind(camera);
+        batcher.clear();
+        for (size_t j = i; j < end; j++) {
+          Mesh *m = items[j].item;
+          batcher.add(m->vertex_count, m->first_index, m->base_vertex,
+                      m->model());
+        }
+        batcher.submit(*first->shader, first->draw_mode, first->index_type);
+      }
+      i = end;
+    }
+  }
+
   bool on_keypress(int key) { return glfwGetKey(window, key) == GLFW_PRESS; }
   bool on_keyrelease(int key) {
     return glfwGetKey(window, key) == GLFW_RELEASE;
@@ -233,11 +447,32 @@ class Game {
     }
     return false;
   }
+  // true once when the key goes down, then every frame after it has been
+  // held for KEY_REPEAT_DELAY seconds
+  bool on_keyrepeat(int key) {
+    if (!on_keypress(key)) {
+      held.erase(key);
+      return false;
+    }
+    double now = glfwGetTime();
+    auto it = held.find(key);
+    if (it == held.end()) {
+      held[key] = now;
+      return true;
+    }
+    return now - it->second >= KEY_REPEAT_DELAY;
+  }
   void close() { glfwSetWindowShouldClose(window, true); }
 
-  void add_shape(Mesh *shape) { shapes.push_back(shape); }
-  void add_shapes(std::vector<Mesh *> &shapes) {
-    for (auto &shape : shapes) add_shape(shape);
+  // take over the meshes and return where they now live
+  Mesh *add_shape(Mesh &&shape) {
+    shapes.push_back(std::move(shape));
+    return &shapes.back();
+  }
+  std::vector<Mesh *> add_shapes(std::vector<Mesh> &&meshes) {
+    std::vector<Mesh *> added;
+    for (auto &mesh : meshes) added.push_back(add_shape(std::move(mesh)));
+    return added;
   }
 
   void kbd_move_camera() {
@@ -268,38 +503,43 @@ class Game {
   }
 
   void basic_lighting() {
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl_state.set(GL_DEPTH_TEST, true);
+    gl_state.set(GL_BLEND, true);
+    gl_state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   }
 
-  void basic_shape_move(Mesh *shape) {
+  // move every shape with the keyboard; the keys are read once and the
+  // transform store applies them to all shapes
+  void basic_shapes_move() {
     const bool shift =
         on_keypress(GLFW_KEY_LEFT_SHIFT) || on_keypress(GLFW_KEY_RIGHT_SHIFT);
     const int sign = shift ? -1 : +1;
 
-    auto &s = shape->state;
-
     const float ANGLE = 1.0f;
     const float DISTANCE = 0.01f;
 
     // translation
-    if (on_keypress(GLFW_KEY_I)) s.position.y += DISTANCE;
-    if (on_keypress(GLFW_KEY_K)) s.position.y -= DISTANCE;
-    if (on_keypress(GLFW_KEY_J)) s.position.x -= DISTANCE;
-    if (on_keypress(GLFW_KEY_L)) s.position.x += DISTANCE;
-    if (on_keypress(GLFW_KEY_O)) s.position.z -= DISTANCE;
-    if (on_keypress(GLFW_KEY_U)) s.position.z += DISTANCE;
+    glm::vec3 step(0.0f);
+    if (on_keypress(GLFW_KEY_I)) step.y += DISTANCE;
+    if (on_keypress(GLFW_KEY_K)) step.y -= DISTANCE;
+    if (on_keypress(GLFW_KEY_J)) step.x -= DISTANCE;
+    if (on_keypress(GLFW_KEY_L)) step.x += DISTANCE;
+    if (on_keypress(GLFW_KEY_O)) step.z -= DISTANCE;
+    if (on_keypress(GLFW_KEY_U)) step.z += DISTANCE;
+    if (step != glm::vec3(0.0f)) transforms.translate_all(step);
 
     // auto rotation
-    if (on_keypress(GLFW_KEY_V)) s.rotation_axis = 1 * sign;
-    if (on_keypress(GLFW_KEY_B)) s.rotation_axis = 2 * sign;
-    if (on_keypress(GLFW_KEY_N)) s.rotation_axis = 3 * sign;
-    if (on_keypress(GLFW_KEY_M)) s.rotation_axis = 0 * sign;
+    if (on_keypress(GLFW_KEY_V)) transforms.spin_all(1 * sign);
+    if (on_keypress(GLFW_KEY_B)) transforms.spin_all(2 * sign);
+    if (on_keypress(GLFW_KEY_N)) transforms.spin_all(3 * sign);
+    if (on_keypress(GLFW_KEY_M)) transforms.spin_all(0);
 
     // manual rotation
-    if (on_keypress(GLFW_KEY_Z)) shape->rotate(BasisVectors::X, ANGLE * sign);
-    if (on_keypress(GLFW_KEY_X)) shape->rotate(BasisVectors::Y, ANGLE * sign);
-    if (on_keypress(GLFW_KEY_C)) shape->rotate(BasisVectors::Z, ANGLE * sign);
+    if (on_keypress(GLFW_KEY_Z))
+      transforms.rotate_all(BasisVectors::X, ANGLE * sign);
+    if (on_keypress(GLFW_KEY_X))
+      transforms.rotate_all(BasisVectors::Y, ANGLE * sign);
+    if (on_keypress(GLFW_KEY_C))
+      transforms.rotate_all(BasisVectors::Z, ANGLE * sign);
   }
 };
@@ -0,0 +1,180 @@
+#pragma once
+
+// standard
+#include <cstdint>
+
+// glad
+#include <glad/glad.h>
+
+// helpers
+#include "stats.hpp"
+
+// cached value that has not been set through the cache yet, or was changed
+// behind its back
+const GLuint GL_STATE_UNKNOWN = ~0u;
+// texture units tracked by the cache
+const int GL_STATE_TEXTURE_UNITS = 8;
+
+// Shadow copy of the GL bindings and enables the engine touches. Every call
+// compares against the cached value and skips the GL call when nothing would
+// change; `skipped` counts the calls that were filtered out. All engine code
+// must change this state through gl_state, otherwise the cache goes stale.
+class GLState {
+ public:
+  uint64_t issued = 0;
+  uint64_t skipped = 0;
+
+  GLState() { invalidate(); }
+
+  // forget everything, e.g. after a new context was made current
+  void invalidate() {
+    program = vertex_array = GL_STATE_UNKNOWN;
+    for (auto &b : buffers) b = GL_STATE_UNKNOWN;
+    unit = GL_STATE_UNKNOWN;
+    for (auto &t : textures) t = GL_STATE_UNKNOWN;
+    for (auto &c : caps) c = GL_STATE_UNKNOWN;
+    blend_src = blend_dst = GL_STATE_UNKNOWN;
+    polygon = GL_STATE_UNKNOWN;
+  }
+
+  void use_program(GLuint id) {
+    if (!changed(program, id)) return;
+    glUseProgram(id);
+    render_stats.program_binds++;
+  }
+
+  void bind_vertex_array(GLuint id) {
+    if (!changed(vertex_array, id)) return;
+    glBindVertexArray(id);
+    render_stats.vao_binds++;
+    // the element array binding is part of the vertex array object
+    buffers[buffer_slot(GL_ELEMENT_ARRAY_BUFFER)] = GL_STATE_UNKNOWN;
+  }
+
+  void bind_buffer(GLenum target, GLuint id) {
+    int slot = buffer_slot(target);
+    if (slot < 0)
+      issue();
+    else if (!changed(buffers[slot], id))
+      return;
+    glBindBuffer(target, id);
+  }
+
+  void active_texture(GLenum texture_unit) {
+    if (!changed(unit, texture_unit - GL_TEXTURE0)) return;
+    glActiveTexture(texture_unit);
+  }
+
+  // bind to the active unit; only GL_TEXTURE_2D bindings are cached
+  void bind_texture(GLenum target, GLuint id) {
+    if (target != GL_TEXTURE_2D || unit >= GL_STATE_TEXTURE_UNITS)
+      issue();
+    else if (!changed(textures[unit], id))
+      return;
+    glBindTexture(target, id);
+    render_stats.texture_binds++;
+  }
+
+  void set(GLenum cap, bool on) {
+    int slot = cap_slot(cap);
+    if (slot < 0)
+      issue();
+    else if (!changed(caps[slot], on))
+      return;
+    if (on)
+      glEnable(cap);
+    else
+      glDisable(cap);
+  }
+
+  void blend_func(GLenum src, GLenum dst) {
+    if (blend_src == src && blend_dst == dst) {
+      skip();
+      return;
+    }
+    blend_src = src, blend_dst = dst;
+    issue();
+    glBlendFunc(src, dst);
+  }
+
+  void polygon_mode(GLenum mode) {
+    if (!changed(polygon, mode)) return;
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+  }
+
+  // deleted objects are unbound by GL; keep the cache in sync with that
+  void forget_program(GLuint id) {
+    // a program deleted while in use stays current until the next
+    // glUseProgram, but its name may be reused afterwards
+    if (program == id) program = GL_STATE_UNKNOWN;
+  }
+  void forget_vertex_array(GLuint id) {
+    if (vertex_array == id) vertex_array = 0;
+  }
+  void forget_buffer(GLuint id) {
+    for (auto &b : buffers)
+      if (b == id) b = 0;
+  }
+  void forget_texture(GLuint id) {
+    for (auto &t : textures)
+      if (t == id) t = 0;
+  }
+
+ private:
+  GLuint program, vertex_array;
+  GLuint buffers[5];
+  GLuint unit;
+  GLuint textures[GL_STATE_TEXTURE_UNITS];
+  GLuint caps[3];
+  GLuint blend_src, blend_dst;
+  GLuint polygon;
+
+  void issue() { issued++; }
+  void skip() {
+    skipped++;
+    render_stats.state_skipped++;
+  }
+
+  // update a cached value; false if the call would have been redundant
+  bool changed(GLuint &cached, GLuint value) {
+    if (cached == value) {
+      skip();
+      return false;
+    }
+    cached = value;
+    issue();
+    return true;
+  }
+
+  static int buffer_slot(GLenum target) {
+    switch (target) {
+      case GL_ARRAY_BUFFER:
+        return 0;
+      case GL_ELEMENT_ARRAY_BUFFER:
+        return 1;
+      case GL_TEXTURE_BUFFER:
+        return 2;
+      case GL_UNIFORM_BUFFER:
+        return 3;
+#ifdef GL_VERSION_4_0
+      case GL_DRAW_INDIRECT_BUFFER:
+        return 4;
+#endif
+    }
+    return -1;
+  }
+
+  static int cap_slot(GLenum cap) {
+    switch (cap) {
+      case GL_BLEND:
+        return 0;
+      case GL_CULL_FACE:
+        return 1;
+      case GL_DEPTH_TEST:
+        return 2;
+    }
+    return -1;
+  }
+};
+
+GLState gl_state;
@@ -0,0 +1,287 @@
+#pragma once
+
+// standard
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// glad
+#include <glad/glad.h>
+
+// glm
+#include <glm/glm.hpp>
+
+// helpers
+#include "batch.hpp"
+#include "camera.hpp"
+#include "glstate.hpp"
+#include "resources.hpp"
+#include "shape.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+#include "transform.hpp"
+
+// instance input of shaders/cull.comp, in std430 layout; the model matrices
+// come from the transform store
+struct GpuInstance {
+  glm::vec4 sphere;  // model space center and radius
+  GLint first_lod;   // levels in the lod table, finest first
+  GLint lod_count;
+  GLint level;  // current level, kept by the shader for the hysteresis
+  GLint pad;
+};
+static_assert(sizeof(GpuInstance) == 32,
+              "GpuInstance does not match shaders/cull.comp");
+
+// a level of detail: its index range and side count
+struct GpuLod {
+  GLuint count;
+  GLuint first_index;
+  GLint base_vertex;
+  GLfloat sides;
+};
+static_assert(sizeof(GpuLod) == 16, "GpuLod does not match shaders/cull.comp");
+
+// Draws many instances of one mesh with culling and level of detail done on
+// the GPU. A compute pass tests each instance's bounding sphere against the
+// frustum, picks its level like LodSelector and writes a draw command and
+// model matrix for it; one multi-draw then draws whatever it wrote. On the
+// CPU a frame only uploads the matrices of the instances the transform store
+// logged as moved, in one write of the range they span.
+//
+// With GL 4.6 the visible instances are appended behind an atomic counter
+// and drawn with glMultiDrawElementsIndirectCount. With GL 4.3 to 4.5, e.g.
+// llvmpipe, every instance keeps its command slot, culled ones with an
+// empty command, and glMultiDrawElementsIndirect goes over all of them.
+// Without GL 4.3 `available` is false and instances must be drawn on the
+// CPU path.
+class GpuCuller {
+ public:
+  bool available = false;
+  bool compact = false;  // glMultiDrawElementsIndirectCount available
+  bool enabled = false;
+  float pixel_error = 0.5f;
+  float hysteresis = 0.25f;
+
+  void init() {
+#ifdef GL_VERSION_4_3
+    available = GLAD_GL_VERSION_4_3;
+#endif
+#ifdef GL_VERSION_4_6
+    compact = GLAD_GL_VERSION_4_6;
+#endif
+    if (!available) return;
+    move_log = transforms.watch();
+    glGenBuffers(BUFFER_COUNT, buffers);
+    glGenBuffers(READBACK_FRAMES, readback);
+    for (auto id : readback) {
+      gl_state.bind_buffer(GL_COPY_WRITE_BUFFER, id);
+      glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), NULL, GL_STREAM_READ);
+    }
+    glGenTextures(1, &models_texture);
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+  }
+
+  // must run while the GL context is still alive
+  void destroy() {
+    if (!available) return;
+    glDeleteBuffers(BUFFER_COUNT, buffers);
+    for (auto id : buffers) gl_state.forget_buffer(id);
+    for (auto &fence : fences)
+      if (fence) glDeleteSync(fence), fence = 0;
+    glDeleteBuffers(READBACK_FRAMES, readback);
+    glDeleteTextures(1, &models_texture);
+    gl_state.forget_texture(models_texture);
+  }
+
+  size_t size() const { return models.size(); }
+
+  // Draw `instances` of the shader, texture, vertex array and primitive
+  // mode of `mesh`, whose index buffer the levels in `lods` point into,
+  // each placed by its slot in `handles`. The mesh itself is not drawn by
+  // the culler.
+  void set(Mesh *mesh, const std::vector<GpuLod> &lods,
+           const std::vector<GpuInstance> &instances,
+           const std::vector<TransformHandle> &handles) {
+    if (!available) return;
+    TraceScope trace("gpu cull upload", "gl");
+    this->mesh = mesh;
+    size_t n = instances.size();
+    // a matrix is four texels of the models buffer texture
+    if (n * 4 > size_t(max_texels)) {
+      n = max_texels / 4;
+      std::cout << "GPU culling draws the first " << n << " of "
+                << instances.size() << " instances" << std::endl;
+    }
+    models.resize(n);
+    instance_of.assign(transforms.size(), -1);
+    for (size_t i = 0; i < n; i++) {
+      models[i] = transforms.model(handles[i]);
+      instance_of[handles[i]] = i;
+    }
+    transforms.clear_moved(move_log);
+
+    upload(INSTANCES, instances.data(), n * sizeof(GpuInstance));
+    upload(TRANSFORMS, models.data(), n * sizeof(glm::mat4));
+    upload(LODS, lods.data(), lods.size() * sizeof(GpuLod));
+    upload(COMMANDS, NULL, n * sizeof(DrawElementsIndirectCommand));
+    upload(MODELS, NULL, n * sizeof(glm::mat4));
+    GLuint zero = 0;
+    upload(COUNTER, &zero, sizeof(zero));
+    std::vector<GLint> ids(n);
+    for (size_t i = 0; i < n; i++) ids[i] = i;
+    upload(DRAW_IDS, ids.data(), n * sizeof(GLint));
+
+    gl_state.active_texture(GL_TEXTURE0 + MODELS_UNIT);
+    gl_state.bind_texture(GL_TEXTURE_BUFFER, models_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffers[MODELS]);
+    gl_state.active_texture(GL_TEXTURE0);
+  }
+
+  // upload the matrices of the instances moved since the last call, as one
+  // write from the first of them to the last
+  void update_models() {
+    if (!available) return;
+    size_t lo = models.size(), hi = 0;
+    for (TransformHandle h : transforms.moved(move_log)) {
+      int i = h < instance_of.size() ? instance_of[h] : -1;
+      if (i < 0) continue;
+      models[i] = transforms.model(h);
+      lo = std::min(lo, size_t(i));
+      hi = std::max(hi, size_t(i) + 1);
+    }
+    transforms.clear_moved(move_log);
+    if (lo >= hi) return;
+    size_t bytes = (hi - lo) * sizeof(glm::mat4);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, buffers[TRANSFORMS]);
+    glBufferSubData(GL_ARRAY_BUFFER, lo * sizeof(glm::mat4), bytes,
+                    &models[lo]);
+    render_stats.buffer_bytes += bytes;
+  }
+
+  // cull the instances against the camera and draw them
+  void render(Camera &camera, float viewport_height) {
+    if (!available || !enabled || !mesh || models.empty()) return;
+#ifdef GL_VERSION_4_3
+    TraceScope trace("gpu cull", "gl");
+    GLuint n = models.size();
+
+    // the count copied out READBACK_FRAMES frames ago, read only once its
+    // fence has signalled so this never waits on the GPU; until then the
+    // last count read stands
+    GLsync &fence = fences[frame];
+    if (fence) {
+      GLenum state = glClientWaitSync(fence, 0, 0);
+      if (state == GL_ALREADY_SIGNALED || state == GL_CONDITION_SATISFIED) {
+        gl_state.bind_buffer(GL_COPY_READ_BUFFER, readback[frame]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(drawn), &drawn);
+        glDeleteSync(fence);
+        fence = 0;
+      }
+    }
+    render_stats.gpu_instances += n;
+    render_stats.gpu_drawn += drawn;
+    update_models();
+
+    GLuint zero = 0;
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, buffers[COUNTER]);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(zero), &zero);
+
+    Shader *cull = resources.compute_shader("shaders/cull.comp");
+    cull->use();
+    cull->setInt("instance_count", n);
+    for (int p = 0; p < 6; p++)
+      cull->setVec4("planes[" + std::to_string(p) + "]",
+                    camera.frustum.planes[p]);
+    cull->setMat4("view", camera.GetViewMatrix());
+    cull->setFloat("scale", camera.GetProjectionMatrix()[1][1] * 0.5f *
+                                viewport_height);
+    cull->setFloat("pixel_error", pixel_error);
+    cull->setFloat("hysteresis", hysteresis);
+    cull->setBool("compact", compact);
+    for (int b = INSTANCES; b <= TRANSFORMS; b++)
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, b, buffers[b]);
+    glDispatchCompute((n + 63) / 64, 1, 1);
+    // the draw reads the commands and matrices, the copy below and the next
+    // frame's reset touch the counter
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT |
+                    GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // a slot whose count has not been read yet keeps it
+    if (!fence) {
+      gl_state.bind_buffer(GL_COPY_READ_BUFFER, buffers[COUNTER]);
+      gl_state.bind_buffer(GL_COPY_WRITE_BUFFER, readback[frame]);
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                          sizeof(GLuint));
+      fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    frame = (frame + 1) % READBACK_FRAMES;
+
+    mesh->bind(camera);
+    Shader &shader = *mesh->shader;
+    gl_state.active_texture(GL_TEXTURE0 + MODELS_UNIT);
+    gl_state.bind_texture(GL_TEXTURE_BUFFER, models_texture);
+    shader.setBool("batched", true);
+    shader.setBool("indirect", true);
+
+    // draw ids 0..n-1, read per instance starting at baseInstance; the
+    // attribute state lives in the bound vertex array
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, buffers[DRAW_IDS]);
+    glVertexAttribIPointer(DRAW_ID_ATTRIBUTE, 1, GL_INT, 0, 0);
+    glVertexAttribDivisor(DRAW_ID_ATTRIBUTE, 1);
+    glEnableVertexAttribArray(DRAW_ID_ATTRIBUTE);
+
+    gl_state.bind_buffer(GL_DRAW_INDIRECT_BUFFER, buffers[COMMANDS]);
+#ifdef GL_VERSION_4_6
+    if (compact) {
+      gl_state.bind_buffer(GL_PARAMETER_BUFFER, buffers[COUNTER]);
+      glMultiDrawElementsIndirectCount(mesh->draw_mode, mesh->index_type, 0,
+                                       0, n, 0);
+    }
+#endif
+    if (!compact)
+      glMultiDrawElementsIndirect(mesh->draw_mode, mesh->index_type, 0, n, 0);
+    render_stats.draw_calls++;
+
+    shader.setBool("batched", false);
+    gl_state.active_texture(GL_TEXTURE0);
+#endif
+  }
+
+ private:
+  // shader storage bindings of shaders/cull.comp, then the draw ids
+  enum {
+    INSTANCES,
+    LODS,
+    COMMANDS,
+    MODELS,
+    COUNTER,
+    TRANSFORMS,
+    DRAW_IDS,
+    BUFFER_COUNT
+  };
+  GLuint buffers[BUFFER_COUNT] = {0};
+  GLuint models_texture = 0;
+  GLint max_texels = 0;
+  Mesh *mesh = NULL;
+  // copies of the instance matrices in TRANSFORMS, the culler's log of
+  // moved slots in the transform store and the instance of each slot, -1
+  // for slots of other meshes
+  std::vector<glm::mat4> models;
+  int move_log = -1;
+  std::vector<int> instance_of;
+
+  // counts copied out of the counter, each read back a few frames later
+  static const int READBACK_FRAMES = 3;
+  GLuint readback[READBACK_FRAMES] = {0};
+  GLsync fences[READBACK_FRAMES] = {0};
+  int frame = 0;  // readback slot of this frame
+  GLuint drawn = 0;  // last count read
+
+  void upload(int buffer, const void *data, size_t bytes) {
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, buffers[buffer]);
+    glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_DYNAMIC_DRAW);
+    if (data) render_stats.buffer_bytes += bytes;
+  }
+};
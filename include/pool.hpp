@@ -0,0 +1,135 @@
+#pragma once
+
+// standard
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// helpers
+#include "trace.hpp"
+
+// Worker threads for data parallel loops. The workers start on first use and
+// sleep between jobs; the calling thread works on the job too and returns
+// once all of it is done. One job runs at a time, and a parallel_for issued
+// from inside a job runs serially on the calling thread.
+class ThreadPool {
+ public:
+  // `threads` counts the caller; 0 uses one per hardware thread
+  ThreadPool(int threads = 0) : threads(threads) {}
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto &t : workers) t.join();
+  }
+
+  // threads taking part in a job, counting the caller
+  int size() {
+    start();
+    return workers.size() + 1;
+  }
+
+  // call body(begin, end) over [0, count) in chunks of about `grain`
+  void parallel_for(size_t count, size_t grain,
+                    const std::function<void(size_t, size_t)> &body) {
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    if (inside_job() || count <= grain || size() == 1) {
+      body(0, count);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      job = &body;
+      job_count = count;
+      job_grain = grain;
+      next = 0;
+      pending = (count + grain - 1) / grain;
+      generation++;
+    }
+    wake.notify_all();
+    run_chunks();
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this]() { return pending == 0 && active == 0; });
+    job = NULL;
+  }
+
+  // split [0, count) into `chunks` even parts and call body(i, begin, end)
+  // for each
+  void parallel_chunks(
+      size_t count, size_t chunks,
+      const std::function<void(size_t, size_t, size_t)> &body) {
+    parallel_for(chunks, 1, [&](size_t first, size_t last) {
+      for (size_t i = first; i < last; i++)
+        body(i, count * i / chunks, count * (i + 1) / chunks);
+    });
+  }
+
+ private:
+  int threads;
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake, done;
+  bool stopping = false;
+
+  // the current job; next and pending count chunks
+  const std::function<void(size_t, size_t)> *job = NULL;
+  size_t job_count = 0, job_grain = 1;
+  std::atomic<size_t> next{0};
+  size_t pending = 0;
+  int active = 0;  // workers inside run_chunks()
+  uint64_t generation = 0;
+
+  static bool &inside_job() {
+    thread_local bool inside = false;
+    return inside;
+  }
+
+  void start() {
+    if (workers.size() > 0) return;
+    if (threads <= 0) threads = std::thread::hardware_concurrency();
+    for (int i = 1; i < threads; i++)
+      workers.emplace_back([this, i]() { work(i); });
+  }
+
+  void work(int index) {
+    tracer.name_thread("worker " + std::to_string(index));
+    uint64_t seen = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock,
+                  [&]() { return stopping || (job && generation != seen); });
+        if (stopping) return;
+        seen = generation;
+        active++;
+      }
+      run_chunks();
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--active == 0) done.notify_all();
+    }
+  }
+
+  // take chunks of the current job until none are left
+  void run_chunks() {
+    inside_job() = true;
+    size_t finished = 0, chunks = (job_count + job_grain - 1) / job_grain;
+    for (size_t c; (c = next.fetch_add(1)) < chunks; finished++) {
+      size_t begin = c * job_grain;
+      (*job)(begin, std::min(begin + job_grain, job_count));
+    }
+    inside_job() = false;
+    if (finished == 0) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    pending -= finished;
+  }
+};
+
+ThreadPool thread_pool;
@@ -0,0 +1,201 @@
+#pragma once
+
+// standard
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+// glad
+#include <glad/glad.h>
+
+// helpers
+#include "trace.hpp"
+
+// number of frames a GPU timer query may stay in flight before it is read
+// back; results are always at least this many frames old, so reading them never
+// waits for the GPU
+const int PROFILER_FRAMES = 4;
+// number of samples kept for the rolling average
+const int PROFILER_WINDOW = 64;
+
+// timing statistic of a single zone, in milliseconds
+struct Stat {
+  float last = 0.0f;  // most recent sample
+  float avg = 0.0f;   // rolling average over the last PROFILER_WINDOW samples
+  float min = 0.0f;
+  float max = 0.0f;
+  float samples[PROFILER_WINDOW] = {};
+  int count = 0;  // number of valid samples in the window
+  int head = 0;   // next slot to overwrite
+
+  void add(float ms) {
+    last = ms;
+    samples[head] = ms;
+    head = (head + 1) % PROFILER_WINDOW;
+    if (count < PROFILER_WINDOW) count++;
+
+    float sum = 0.0f;
+    min = max = ms;
+    for (int i = 0; i < count; i++) {
+      sum += samples[i];
+      if (samples[i] < min) min = samples[i];
+      if (samples[i] > max) max = samples[i];
+    }
+    avg = sum / count;
+  }
+};
+
+// GL_TIME_ELAPSED query issued in some frame, waiting to be read back
+struct GpuQuery {
+  GLuint ID;
+  const char *name;
+};
+
+// CPU and GPU timings of the frame. CPU zones are timed with a steady clock,
+// GPU passes with GL_TIME_ELAPSED queries kept in a ring of PROFILER_FRAMES
+// frames. Both land in the same `stats` map as "cpu <name>" and "gpu <name>".
+class Profiler {
+ public:
+  std::map<std::string, Stat> stats;
+  bool enabled = true;
+  int frame = 0;
+  int dropped = 0;  // GPU samples still unavailable when their slot came round
+
+  // the queries are released by destroy(), while the context is alive; by the
+  // time globals and Game members are destroyed glfwTerminate has run
+  ~Profiler() {
+    for (auto &slot : pool)
+      if (!slot.empty()) {
+        std::fprintf(stderr, "Profiler queries leaked, destroy() not called\n");
+        break;
+      }
+  }
+
+  // must run while the GL context is still alive
+  void destroy() {
+    for (auto &slot : pool) {
+      if (!slot.empty()) glDeleteQueries(slot.size(), slot.data());
+      slot.clear();
+    }
+    for (auto &used : issued) used.clear();
+  }
+
+  void begin_frame() {
+    frame_start = now();
+    collect();
+  }
+
+  void end_frame() {
+    add("cpu frame", frame_start);
+    tracer.record("frame", "frame", tracer.at(frame_start), tracer.now());
+    frame++;
+  }
+
+  // CPU-only zone, for work that issues no GL commands
+  void begin_zone(const char *name) { zones.push_back({name, now()}); }
+  void end_zone(const char *name) {
+    const Zone &zone = zones.back();
+    if (std::strcmp(zone.name, name) != 0)
+      std::fprintf(stderr, "Profiler zone %s ended as %s\n", zone.name, name);
+    add(std::string("cpu ") + name, zone.start);
+    tracer.record(name, "zone", tracer.at(zone.start), tracer.now());
+    zones.pop_back();
+  }
+
+  // CPU zone with a GPU timer query around it. GL_TIME_ELAPSED queries can not
+  // nest, so passes must not overlap each other.
+  void begin_pass(const char *name) {
+    begin_zone(name);
+    if (!enabled) return;
+    auto &slot = pool[frame % PROFILER_FRAMES];
+    auto &used = issued[frame % PROFILER_FRAMES];
+    if (used.size() == slot.size()) {
+      GLuint id;
+      glGenQueries(1, &id);
+      slot.push_back(id);
+    }
+    GLuint id = slot[used.size()];
+    used.push_back({id, name});
+    glBeginQuery(GL_TIME_ELAPSED, id);
+  }
+  void end_pass(const char *name) {
+    if (enabled) glEndQuery(GL_TIME_ELAPSED);
+    end_zone(name);
+  }
+
+  // one line per zone: last sample and rolling average
+  std::vector<std::string> report() {
+    std::vector<std::string> lines;
+    char line[128];
+    for (auto &pair : stats) {
+      snprintf(line, sizeof(line), "%s %.3f ms (avg %.3f)", pair.first.c_str(),
+               pair.second.last, pair.second.avg);
+      lines.push_back(line);
+    }
+    return lines;
+  }
+
+ private:
+  typedef Tracer::clock clock;
+  clock::time_point frame_start;
+  // open zones, innermost last
+  struct Zone {
+    const char *name;
+    clock::time_point start;
+  };
+  std::vector<Zone> zones;
+  // query objects owned by each frame slot, and the ones issued this round
+  std::vector<GLuint> pool[PROFILER_FRAMES];
+  std::vector<GpuQuery> issued[PROFILER_FRAMES];
+
+  clock::time_point now() { return clock::now(); }
+
+  void add(const std::string &name, clock::time_point start) {
+    std::chrono::duration<float, std::milli> ms = now() - start;
+    stats[name].add(ms.count());
+  }
+
+  // read back the queries issued PROFILER_FRAMES frames ago, whose slot is
+  // about to be reused. A result that is still not available is dropped
+  // rather than waited for.
+  void collect() {
+    auto &used = issued[frame % PROFILER_FRAMES];
+    for (auto &q : used) {
+      GLint available = 0;
+      glGetQueryObjectiv(q.ID, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available) {
+        dropped++;
+        continue;
+      }
+      GLuint64 ns = 0;
+      glGetQueryObjectui64v(q.ID, GL_QUERY_RESULT, &ns);
+      stats[std::string("gpu ") + q.name].add(ns / 1e6f);
+    }
+    used.clear();
+  }
+};
+
+// scoped CPU zone
+struct ProfileZone {
+  Profiler &profiler;
+  const char *name;
+  ProfileZone(Profiler &profiler, const char *name)
+      : profiler(profiler), name(name) {
+    profiler.begin_zone(name);
+  }
+  ~ProfileZone() { profiler.end_zone(name); }
+};
+
+// scoped CPU zone plus GPU timer query
+struct ProfilePass {
+  Profiler &profiler;
+  const char *name;
+  ProfilePass(Profiler &profiler, const char *name)
+      : profiler(profiler), name(name) {
+    profiler.begin_pass(name);
+  }
+  ~ProfilePass() { profiler.end_pass(name); }
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+// standard
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+// glad
+#include <glad/glad.h>
+
+// bits of each field in the sort key, from most to least significant. Draws
+// are grouped by program first since that is the most expensive switch, then
+// by texture and vertex array, and finally ordered front to back so early
+// depth testing rejects occluded fragments.
+const int SORT_PROGRAM_BITS = 12;
+const int SORT_TEXTURE_BITS = 12;
+const int SORT_VAO_BITS = 16;
+const int SORT_DEPTH_BITS = 24;
+
+// 64-bit pipeline state key of a draw. Object names wider than their field
+// wrap around, which only costs some grouping, never correctness.
+uint64_t sort_key(GLuint program, GLuint texture, GLuint vao, float depth,
+                  float far_plane) {
+  const uint64_t depth_max = (1ull << SORT_DEPTH_BITS) - 1;
+  float d = depth / far_plane;
+  if (d < 0.0f) d = 0.0f;
+  if (d > 1.0f) d = 1.0f;
+  uint64_t key = program & ((1u << SORT_PROGRAM_BITS) - 1);
+  key = key << SORT_TEXTURE_BITS | (texture & ((1u << SORT_TEXTURE_BITS) - 1));
+  key = key << SORT_VAO_BITS | (vao & ((1u << SORT_VAO_BITS) - 1));
+  key = key << SORT_DEPTH_BITS | (uint64_t)(d * depth_max);
+  return key;
+}
+
+// Draws submitted during a frame, sorted by key before they are executed.
+// clear() keeps the storage, so once the queue has seen its largest frame it
+// no longer allocates.
+template <typename T>
+class RenderQueue {
+ public:
+  struct Item {
+    uint64_t key;
+    T *item;
+  };
+  std::vector<Item> items;
+
+  void clear() { items.clear(); }
+  void submit(uint64_t key, T *item) { items.push_back({key, item}); }
+
+  // least significant digit radix sort over the 8 key bytes. All histograms
+  // are built in one pass, and bytes that are equal across every key are
+  // skipped, which is most of them for small scenes.
+  void sort() {
+    size_t n = items.size();
+    if (n < 2) return;
+    if (scratch.size() < n) scratch.resize(n);
+
+    size_t counts[8][256];
+    std::memset(counts, 0, sizeof(counts));
+    for (auto &it : items)
+      for (int b = 0; b < 8; b++) counts[b][(it.key >> (8 * b)) & 0xff]++;
+
+    Item *src = items.data(), *dst = scratch.data();
+    for (int b = 0; b < 8; b++) {
+      size_t *count = counts[b];
+      if (count[(src[0].key >> (8 * b)) & 0xff] == n) continue;
+
+      size_t offset = 0;
+      for (int i = 0; i < 256; i++) {
+        size_t c = count[i];
+        count[i] = offset;
+        offset += c;
+      }
+      for (size_t i = 0; i < n; i++)
+        dst[count[(src[i].key >> (8 * b)) & 0xff]++] = src[i];
+      std::swap(src, dst);
+    }
+    if (src != items.data()) std::memcpy(items.data(), src, n * sizeof(Item));
+  }
+
+ private:
+  std::vector<Item> scratch;
+};
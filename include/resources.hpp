@@ -0,0 +1,85 @@
+#pragma once
+
+// standard
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+
+// helpers
+#include "buffers.hpp"
+#include "shader.hpp"
+
+// Shaders and textures loaded once per path and shared by every mesh that
+// asks for them, so regenerating shapes compiles and decodes nothing.
+class Resources {
+ public:
+  Shader *shader(const std::string &vertex_path,
+                 const std::string &fragment_path) {
+    auto key = std::make_pair(vertex_path, fragment_path);
+    auto it = shaders.find(key);
+    if (it == shaders.end())
+      it = shaders
+               .emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                        std::forward_as_tuple(vertex_path, fragment_path))
+               .first;
+    return &it->second;
+  }
+
+  // a program with tessellation stages, see Shader
+  Shader *shader(const std::string &vertex_path,
+                 const std::string &fragment_path,
+                 const std::string &control_path,
+                 const std::string &evaluation_path) {
+    auto key = std::make_tuple(vertex_path, fragment_path, control_path,
+                               evaluation_path);
+    auto it = tessellation_shaders.find(key);
+    if (it == tessellation_shaders.end())
+      it = tessellation_shaders
+               .emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                        std::forward_as_tuple(vertex_path, fragment_path,
+                                              control_path, evaluation_path))
+               .first;
+    return &it->second;
+  }
+
+  // a compute program, see Shader
+  Shader *compute_shader(const std::string &path) {
+    auto it = compute_shaders.find(path);
+    if (it == compute_shaders.end())
+      it = compute_shaders
+               .emplace(std::piecewise_construct, std::forward_as_tuple(path),
+                        std::forward_as_tuple(path))
+               .first;
+    return &it->second;
+  }
+
+  Texture *texture(const std::string &path) {
+    auto it = textures.find(path);
+    if (it == textures.end())
+      it = textures
+               .emplace(std::piecewise_construct, std::forward_as_tuple(path),
+                        std::forward_as_tuple(path))
+               .first;
+    return &it->second;
+  }
+
+  // free everything; must run while the GL context is still alive
+  void clear() {
+    shaders.clear();
+    tessellation_shaders.clear();
+    compute_shaders.clear();
+    textures.clear();
+  }
+
+ private:
+  // map nodes never move, so the returned pointers stay valid
+  std::map<std::pair<std::string, std::string>, Shader> shaders;
+  std::map<std::tuple<std::string, std::string, std::string, std::string>,
+           Shader>
+      tessellation_shaders;
+  std::map<std::string, Shader> compute_shaders;
+  std::map<std::string, Texture> textures;
+};
+
+Resources resources;
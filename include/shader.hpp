@@ -4,96 +4,123 @@
 
 #include <fstream>
 #include <iostream>
-#include <sstream>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
 // helpers
+#include "deletion.hpp"
+#include "glstate.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 #include "utils.hpp"
 
 class Shader {
  public:
-  GLuint ID;
-  ~Shader() { glDeleteProgram(ID); }
+  GLuint ID = 0;
+  ~Shader() {
+    if (ID) deletion_queue.retire_program(ID);
+  }
+  Shader(Shader &&other) noexcept
+      : ID(other.ID), locations(std::move(other.locations)) {
+    other.ID = 0;
+  }
+  Shader &operator=(Shader &&other) noexcept {
+    std::swap(ID, other.ID);
+    std::swap(locations, other.locations);
+    return *this;
+  }
+  Shader(const Shader &) = delete;
+  Shader &operator=(const Shader &) = delete;
   // generate shader from source code
   Shader(std::string vertexCode, std::string fragmentCode, int temp) {
     compile(vertexCode.c_str(), fragmentCode.c_str());
   }
   // generate shader from file
   Shader(std::string vertexPath, std::string fragmentPath) {
-    // 1. retrieve the vertex/fragment source code from filePath
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    // ensure ifstream objects can throw exceptions:
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try {
-      // open files
-      vShaderFile.open(vertexPath.c_str());
-      fShaderFile.open(fragmentPath.c_str());
-      std::stringstream vShaderStream, fShaderStream;
-      // read file's buffer contents into streams
-      vShaderStream << vShaderFile.rdbuf();
-      fShaderStream << fShaderFile.rdbuf();
-      // close file handlers
-      vShaderFile.close();
-      fShaderFile.close();
-      // convert stream into string
-      vertexCode = vShaderStream.str();
-      fragmentCode = fShaderStream.str();
+    std::string vertexCode, fragmentCode;
+    if (read(vertexPath, vertexCode) && read(fragmentPath, fragmentCode))
       compile(vertexCode.c_str(), fragmentCode.c_str());
-    } catch (std::ifstream::failure &e) {
-      std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what()
-                << std::endl;
-    }
+  }
+  // generate shader with tessellation control and evaluation stages from
+  // file; needs GL 4.0
+  Shader(std::string vertexPath, std::string fragmentPath,
+         std::string controlPath, std::string evaluationPath) {
+    std::string vertexCode, fragmentCode, controlCode, evaluationCode;
+    if (read(vertexPath, vertexCode) && read(fragmentPath, fragmentCode) &&
+        read(controlPath, controlCode) && read(evaluationPath, evaluationCode))
+      compile(vertexCode.c_str(), fragmentCode.c_str(), controlCode.c_str(),
+              evaluationCode.c_str());
+  }
+  // generate compute shader from file; needs GL 4.3
+  explicit Shader(std::string computePath) {
+    std::string computeCode;
+    if (read(computePath, computeCode)) compile_compute(computeCode.c_str());
   }
   // activate the shader
-  void use() { glUseProgram(ID); }
+  void use() { gl_state.use_program(ID); }
   // utility uniform functions
   void setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    glUniform1i(uniform(name), (int)value);
   }
   void setInt(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1i(uniform(name), value);
   }
   void setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(uniform(name), value);
+  }
+  // the first `count` elements of a float array
+  void setFloats(const std::string &name, const float *values,
+                 int count) const {
+    glUniform1fv(uniform(name), count, values);
   }
   void setVec2(const std::string &name, const glm::vec2 &value) const {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform2fv(uniform(name), 1, &value[0]);
   }
   void setVec2(const std::string &name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    glUniform2f(uniform(name), x, y);
   }
   void setVec3(const std::string &name, const glm::vec3 &value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform3fv(uniform(name), 1, &value[0]);
   }
   void setVec3(const std::string &name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    glUniform3f(uniform(name), x, y, z);
   }
   void setVec4(const std::string &name, const glm::vec4 &value) const {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform4fv(uniform(name), 1, &value[0]);
   }
   void setVec4(const std::string &name, float x, float y, float z,
                float w) const {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+    glUniform4f(uniform(name), x, y, z, w);
   }
   void setMat2(const std::string &name, const glm::mat2 &mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
+    glUniformMatrix2fv(uniform(name), 1, GL_FALSE,
                        &mat[0][0]);
   }
   void setMat3(const std::string &name, const glm::mat3 &mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
+    glUniformMatrix3fv(uniform(name), 1, GL_FALSE,
                        &mat[0][0]);
   }
   void setMat4(const std::string &name, const glm::mat4 &mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
+    glUniformMatrix4fv(uniform(name), 1, GL_FALSE,
                        &mat[0][0]);
   }
-  void compile(const char *vShaderCode, const char *fShaderCode) {
+  // location of a uniform that is about to be uploaded; asked of GL once
+  GLint uniform(const std::string &name) const {
+    render_stats.uniform_uploads++;
+    auto found = locations.find(name);
+    if (found != locations.end()) return found->second;
+    render_stats.uniform_lookups++;
+    GLint location = glGetUniformLocation(ID, name.c_str());
+    locations.emplace(name, location);
+    return location;
+  }
+  void compile(const char *vShaderCode, const char *fShaderCode,
+               const char *tcShaderCode = NULL,
+               const char *teShaderCode = NULL) {
+    TraceScope trace("shader compile", "shader");
     // 2. compile shaders
-    GLuint vertex, fragment;
+    GLuint vertex, fragment, control = 0, evaluation = 0;
     // vertex shader
     vertex = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertex, 1, &vShaderCode, NULL);
@@ -104,19 +131,79 @@ class Shader {
     glShaderSource(fragment, 1, &fShaderCode, NULL);
     glCompileShader(fragment);
     checkCompileErrors(fragment, "FRAGMENT");
+#ifdef GL_VERSION_4_0
+    // tessellation shaders
+    if (tcShaderCode && teShaderCode) {
+      control = glCreateShader(GL_TESS_CONTROL_SHADER);
+      glShaderSource(control, 1, &tcShaderCode, NULL);
+      glCompileShader(control);
+      checkCompileErrors(control, "TESS_CONTROL");
+      evaluation = glCreateShader(GL_TESS_EVALUATION_SHADER);
+      glShaderSource(evaluation, 1, &teShaderCode, NULL);
+      glCompileShader(evaluation);
+      checkCompileErrors(evaluation, "TESS_EVALUATION");
+    }
+#endif
     // shader Program
     ID = glCreateProgram();
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
+    if (control) glAttachShader(ID, control);
+    if (evaluation) glAttachShader(ID, evaluation);
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM");
     // delete the shaders as they're linked into our program now and no longer
     // necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+    if (control) glDeleteShader(control);
+    if (evaluation) glDeleteShader(evaluation);
+  }
+  void compile_compute(const char *cShaderCode) {
+#ifdef GL_VERSION_4_3
+    TraceScope trace("shader compile", "shader");
+    GLuint compute = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(compute, 1, &cShaderCode, NULL);
+    glCompileShader(compute);
+    checkCompileErrors(compute, "COMPUTE");
+    ID = glCreateProgram();
+    glAttachShader(ID, compute);
+    glLinkProgram(ID);
+    checkCompileErrors(ID, "PROGRAM");
+    glDeleteShader(compute);
+#endif
   }
 
  private:
+  mutable std::unordered_map<std::string, GLint> locations;
+
+  // read a whole source file into `code`, with every `#include "name"`
+  // line replaced by the file `name` next to it
+  static bool read(const std::string &path, std::string &code) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+      std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path
+                << std::endl;
+      return false;
+    }
+    const std::string directive = "#include \"";
+    std::string dir = path.substr(0, path.find_last_of('/') + 1);
+    std::string line, included;
+    code.clear();
+    while (std::getline(file, line)) {
+      if (line.compare(0, directive.size(), directive) != 0) {
+        code += line;
+        code += '\n';
+        continue;
+      }
+      size_t end = line.find('"', directive.size());
+      if (!read(dir + line.substr(directive.size(), end - directive.size()),
+                included))
+        return false;
+      code += included;
+    }
+    return true;
+  }
   // utility function for checking shader compilation/linking errors.
   void checkCompileErrors(unsigned int shader, std::string type) {
     int success;
@@ -1,109 +1,449 @@
 #pragma once
 
+// standard
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 // helpers
+#include "arena.hpp"
+#include "bounds.hpp"
+#include "batch.hpp"
 #include "buffers.hpp"
 #include "camera.hpp"
+#include "queue.hpp"
+#include "resources.hpp"
 #include "shader.hpp"
+#include "span.hpp"
 #include "text.hpp"
+#include "transform.hpp"
+#include "vertex.hpp"
+
+// vertex of shaders/shader.vert
+struct PackedMeshVertex;
+struct MeshVertex {
+  glm::vec3 position;
+  glm::vec3 color;
+  glm::vec2 texture;
+
+  typedef VertexLayout<Attr<3, GLfloat>, Attr<3, GLfloat>, Attr<2, GLfloat>>
+      Layout;
+  typedef PackedMeshVertex Packed;
+
+  void extend(AABB &box) const { box.add(position); }
+};
+static_assert(MeshVertex::Layout::feeds<3, 3, 2>(),
+              "MeshVertex does not match shaders/shader.vert");
+static_assert(sizeof(MeshVertex) == MeshVertex::Layout::stride &&
+                  offsetof(MeshVertex, color) ==
+                      MeshVertex::Layout::offset(1) &&
+                  offsetof(MeshVertex, texture) ==
+                      MeshVertex::Layout::offset(2),
+              "MeshVertex does not match its layout");
+
+// vertex of shaders/sides.vert; position 2 is where the vertex goes when the
+// prism turns into a pyramid
+struct PackedSidesVertex;
+struct SidesVertex {
+  glm::vec3 position;
+  glm::vec3 color;
+  glm::vec2 texture;
+  glm::vec3 position2;
+
+  typedef VertexLayout<Attr<3, GLfloat>, Attr<3, GLfloat>, Attr<2, GLfloat>,
+                       Attr<3, GLfloat>>
+      Layout;
+  typedef PackedSidesVertex Packed;
+
+  void extend(AABB &box) const {
+    box.add(position);
+    box.add(position2);
+  }
+};
+static_assert(SidesVertex::Layout::feeds<3, 3, 2, 3>(),
+              "SidesVertex does not match shaders/sides.vert");
+static_assert(sizeof(SidesVertex) == SidesVertex::Layout::stride &&
+                  offsetof(SidesVertex, color) ==
+                      SidesVertex::Layout::offset(1) &&
+                  offsetof(SidesVertex, texture) ==
+                      SidesVertex::Layout::offset(2) &&
+                  offsetof(SidesVertex, position2) ==
+                      SidesVertex::Layout::offset(3),
+              "SidesVertex does not match its layout");
 
-struct ShapeState {
-  glm::vec3 position = glm::vec3(0.0f);
-  glm::mat4 rotation = glm::mat4(1.0f);
-  int rotation_axis = 0;
-  bool visible = true;
+// vertex of shaders/morph.vert: a prism corner at the largest side count.
+// slot.x is the corner it belongs to, which the shader moves onto the
+// corners of smaller side counts, and slot.y is 1 when it goes to position
+// 2 as the prism turns into a pyramid.
+struct PackedMorphVertex;
+struct MorphVertex {
+  glm::vec3 position;
+  glm::vec3 color;
+  glm::vec2 texture;
+  glm::vec3 position2;
+  glm::vec2 slot;
 
-  void reset() {
-    position = glm::vec3(0.0f);
-    rotation = glm::mat4(1.0f);
-    rotation_axis = 0;
-    visible = true;
+  typedef VertexLayout<Attr<3, GLfloat>, Attr<3, GLfloat>, Attr<2, GLfloat>,
+                       Attr<3, GLfloat>, Attr<2, GLfloat>>
+      Layout;
+  typedef PackedMorphVertex Packed;
+
+  void extend(AABB &box) const {
+    box.add(position);
+    box.add(position2);
   }
 };
+static_assert(MorphVertex::Layout::feeds<3, 3, 2, 3, 2>(),
+              "MorphVertex does not match shaders/morph.vert");
+static_assert(sizeof(MorphVertex) == MorphVertex::Layout::stride &&
+                  offsetof(MorphVertex, position2) ==
+                      MorphVertex::Layout::offset(3) &&
+                  offsetof(MorphVertex, slot) ==
+                      MorphVertex::Layout::offset(4),
+              "MorphVertex does not match its layout");
+
+// The packed vertices store positions as half floats padded to four
+// components and colors as RGBA8, and drop the texture coordinates, which
+// the fragment shaders do not sample: 12 bytes instead of 32 for MeshVertex
+// and 20 instead of 44 for SidesVertex.
+struct HalfPosition {
+  Half xyzw[4];
+
+  HalfPosition(const glm::vec3 &p)
+      : xyzw{to_half(p.x), to_half(p.y), to_half(p.z), to_half(1.0f)} {}
+};
+
+struct ColorRGBA8 {
+  GLubyte rgba[4];
+
+  ColorRGBA8(const glm::vec3 &c)
+      : rgba{to_unorm8(c.r), to_unorm8(c.g), to_unorm8(c.b), 255} {}
+};
+
+struct PackedMeshVertex {
+  HalfPosition position;
+  ColorRGBA8 color;
 
+  typedef VertexLayout<Attr<4, Half>, Attr<4, GLubyte, true>, Unused> Layout;
+
+  PackedMeshVertex(const MeshVertex &v)
+      : position(v.position), color(v.color) {}
+};
+static_assert(PackedMeshVertex::Layout::feeds<3, 3, 2>(),
+              "PackedMeshVertex does not match shaders/shader.vert");
+static_assert(sizeof(PackedMeshVertex) == PackedMeshVertex::Layout::stride &&
+                  offsetof(PackedMeshVertex, color) ==
+                      PackedMeshVertex::Layout::offset(1),
+              "PackedMeshVertex does not match its layout");
+
+struct PackedSidesVertex {
+  HalfPosition position;
+  ColorRGBA8 color;
+  HalfPosition position2;
+
+  typedef VertexLayout<Attr<4, Half>, Attr<4, GLubyte, true>, Unused,
+                       Attr<4, Half>>
+      Layout;
+
+  PackedSidesVertex(const SidesVertex &v)
+      : position(v.position), color(v.color), position2(v.position2) {}
+};
+static_assert(PackedSidesVertex::Layout::feeds<3, 3, 2, 3>(),
+              "PackedSidesVertex does not match shaders/sides.vert");
+static_assert(sizeof(PackedSidesVertex) == PackedSidesVertex::Layout::stride &&
+                  offsetof(PackedSidesVertex, color) ==
+                      PackedSidesVertex::Layout::offset(1) &&
+                  offsetof(PackedSidesVertex, position2) ==
+                      PackedSidesVertex::Layout::offset(3),
+              "PackedSidesVertex does not match its layout");
+
+// slots are small integers, exact as unsigned shorts
+struct PackedMorphVertex {
+  HalfPosition position;
+  ColorRGBA8 color;
+  HalfPosition position2;
+  GLushort slot[2];
+
+  typedef VertexLayout<Attr<4, Half>, Attr<4, GLubyte, true>, Unused,
+                       Attr<4, Half>, Attr<2, GLushort>>
+      Layout;
+
+  PackedMorphVertex(const MorphVertex &v)
+      : position(v.position),
+        color(v.color),
+        position2(v.position2),
+        slot{GLushort(v.slot.x), GLushort(v.slot.y)} {}
+};
+static_assert(PackedMorphVertex::Layout::feeds<3, 3, 2, 3, 2>(),
+              "PackedMorphVertex does not match shaders/morph.vert");
+static_assert(sizeof(PackedMorphVertex) == PackedMorphVertex::Layout::stride &&
+                  offsetof(PackedMorphVertex, position2) ==
+                      PackedMorphVertex::Layout::offset(3) &&
+                  offsetof(PackedMorphVertex, slot) ==
+                      PackedMorphVertex::Layout::offset(4),
+              "PackedMorphVertex does not match its layout");
+
+// vertex of shaders/tess.vert, one per patch: shape holds the ring radius,
+// length and side count of the prism, and patch the sector of the ring and
+// the part (0 base, 1 walls, 2 top) the patch draws
+struct PatchVertex {
+  glm::vec3 shape;
+  glm::vec2 patch;
+
+  typedef VertexLayout<Attr<3, GLfloat>, Attr<2, GLfloat>> Layout;
+
+  void extend(AABB &box) const {
+    box.add(glm::vec3(-shape.x, -shape.x, 0.0f));
+    box.add(glm::vec3(shape.x, shape.x, shape.y));
+  }
+};
+static_assert(PatchVertex::Layout::feeds<3, 2>(),
+              "PatchVertex does not match shaders/tess.vert");
+static_assert(sizeof(PatchVertex) == PatchVertex::Layout::stride &&
+                  offsetof(PatchVertex, patch) ==
+                      PatchVertex::Layout::offset(1),
+              "PatchVertex does not match its layout");
+
+// Half floats resolve about 1/2000 of a coordinate's magnitude, so positions
+// keep within 1/1000 of the mesh size while the mesh sits near its own
+// origin, which generated meshes do.
+bool half_positions_fit(const AABB &box) {
+  if (box.empty()) return false;
+  glm::vec3 size = box.size();
+  float extent = glm::max(size.x, glm::max(size.y, size.z));
+  return box.reach() <= 2.0f * extent && box.reach() < 65504.0f;
+}
+
+// vertex and index data in the most compact format that fits, see Mesh
+struct PackedGeometry {
+  const VertexFormat *format;
+  const void *vertices;
+  GLuint vertex_count;
+  GLenum index_type;
+  const void *indices;
+  GLuint index_count;
+  AABB bounds;  // of the vertices, in both positions
+};
+
+// Conversion goes through scratch buffers that keep their storage between
+// calls, so the result is only valid until the next call for the same vertex
+// type.
+template <typename Vertex>
+PackedGeometry pack_geometry(Span<const Vertex> vertices,
+                             Span<const GLuint> indices) {
+  typedef typename PackedVertex<Vertex>::type Packed;
+  PackedGeometry g;
+  g.format = &Vertex::Layout::format;
+  g.vertices = vertices.data();
+  g.vertex_count = vertices.size();
+  g.index_type = GL_UNSIGNED_INT;
+  g.indices = indices.data();
+  g.index_count = indices.size();
+  for (auto &v : vertices) v.extend(g.bounds);
+  if constexpr (!std::is_same<Packed, Vertex>::value) {
+    static std::vector<Packed> packed;
+    if (half_positions_fit(g.bounds)) {
+      packed.clear();
+      packed.reserve(vertices.size());
+      for (auto &v : vertices) packed.emplace_back(v);
+      g.format = &Packed::Layout::format;
+      g.vertices = packed.data();
+    }
+  }
+
+  static std::vector<GLushort> short_indices;
+  if (vertices.size() <= 65536) {
+    short_indices.assign(indices.begin(), indices.end());
+    g.index_type = GL_UNSIGNED_SHORT;
+    g.indices = short_indices.data();
+  }
+  return g;
+}
+
+// A mesh only references its data: vertices and indices go straight from the
+// caller's buffers into the arena, and the shader, texture and vertex array
+// are shared. Meshes are move-only, like the GL handles.
+//
+// Vertices are packed on upload when their struct has a Packed form and the
+// positions survive half precision, and meshes of up to 65536 vertices get
+// 16-bit indices.
 class Mesh {
  public:
-  Shader *shader;
-  Texture *texture;
-  GLenum draw_mode;
-  VAO *vao;
-  VBO *vbo;
-  EBO *ebo;
+  Shader *shader = NULL;
+  Texture *texture = NULL;
+  GLenum draw_mode = GL_TRIANGLES;
+  VAO *vao = NULL;  // shared by every mesh in the same arena page
+  ArenaAllocation allocation;
   int vertex_count = 0;
-  ShapeState state;
-  bool my_shader_and_texture = false;
+  GLuint first_index = 0;  // index and vertex offset inside shared buffers
+  GLint base_vertex = 0;
+  GLenum index_type = GL_UNSIGNED_INT;
+  // placement and visibility, in the transform store
+  TransformHandle transform = NO_TRANSFORM;
+  // model space bounds of what the mesh shows; meshes without them are
+  // never culled
+  AABB bounds;
+  bool bounded = false;
 
-  Mesh(std::vector<GLfloat> vertices, std::vector<GLuint> indices,
+  // `vertices` is any contiguous container of a vertex struct with a Layout.
+  // Shader and texture are shared through the resource cache.
+  template <typename Vertices>
+  Mesh(const Vertices &vertices, Span<const GLuint> indices,
        GLenum draw_mode = GL_TRIANGLES,
-       std::string vertex_path = "shaders/shader.vert",
-       std::string fragment_path = "shaders/shader.frag",
-       std::string texture_path = "textures/cement_wall.jpeg",
-       std::vector<std::tuple<GLint, GLenum>> attributes =
-           {
-               {3, GL_FLOAT},  // position
-               {3, GL_FLOAT},  // color
-               {2, GL_FLOAT},  // texture
-           })
-      : draw_mode(draw_mode) {
-    vertex_count = indices.size();
-    shader = new Shader(vertex_path, fragment_path);
-    texture = new Texture(texture_path);
-
-    vao = new VAO();
-    vbo = new VBO(vertices);
-    ebo = new EBO(indices);
-    // vao->bind();
-    // vbo->bind();
-    // ebo->bind();
-    load_attributes(attributes);
-    // vao->unbind();
-    // vbo->unbind();
-    // ebo->unbind();
-  }
-
-  Mesh(std::vector<GLfloat> vertices, std::vector<GLuint> indices,
-       GLenum draw_mode, Shader *shader, Texture *texture,
-       std::vector<std::tuple<GLint, GLenum>> attributes =
-           {
-               {3, GL_FLOAT},  // position
-               {3, GL_FLOAT},  // color
-               {2, GL_FLOAT}   // texture
-           })
-      : draw_mode(draw_mode), shader(shader), texture(texture) {
-    my_shader_and_texture = true;
-    vertex_count = indices.size();
-    vao = new VAO();
-    vbo = new VBO(vertices);
-    ebo = new EBO(indices);
-    // vao->bind();
-    // vbo->bind();
-    // ebo->bind();
-    load_attributes(attributes);
-    // vao->unbind();
-    // vbo->unbind();
-    // ebo->unbind();
+       const std::string &vertex_path = "shaders/shader.vert",
+       const std::string &fragment_path = "shaders/shader.frag",
+       const std::string &texture_path = "textures/cement_wall.jpeg")
+      : Mesh(vertices, indices, draw_mode,
+             resources.shader(vertex_path, fragment_path),
+             resources.texture(texture_path)) {}
+
+  // a mesh drawing geometry owned elsewhere, see show()
+  Mesh(const ArenaRange &range, GLenum draw_mode = GL_TRIANGLES,
+       const std::string &vertex_path = "shaders/shader.vert",
+       const std::string &fragment_path = "shaders/shader.frag",
+       const std::string &texture_path = "textures/cement_wall.jpeg")
+      : shader(resources.shader(vertex_path, fragment_path)),
+        texture(resources.texture(texture_path)),
+        draw_mode(draw_mode) {
+    transform = transforms.add();
+    show(range);
+    bind_samplers();
+  }
+
+  // shader and texture are owned by the caller and must outlive the mesh
+  template <typename Vertices>
+  Mesh(const Vertices &vertices, Span<const GLuint> indices,
+       GLenum draw_mode, Shader *shader, Texture *texture)
+      : shader(shader), texture(texture), draw_mode(draw_mode) {
+    transform = transforms.add();
+    reshape(vertices, indices);
+    bind_samplers();
   }
 
   ~Mesh() {
-    if (my_shader_and_texture) {
-      delete shader;
-      delete texture;
+    arena.release(allocation);
+    transforms.remove(transform);
+  }
+  Mesh(Mesh &&other) noexcept { *this = std::move(other); }
+  Mesh &operator=(Mesh &&other) noexcept {
+    if (this == &other) return *this;
+    arena.release(allocation);
+    transforms.remove(transform);
+    shader = other.shader;
+    texture = other.texture;
+    draw_mode = other.draw_mode;
+    vao = other.vao;
+    allocation = other.allocation;
+    vertex_count = other.vertex_count;
+    first_index = other.first_index;
+    base_vertex = other.base_vertex;
+    index_type = other.index_type;
+    transform = other.transform;
+    bounds = other.bounds;
+    bounded = other.bounded;
+    other.allocation.page = NULL;
+    other.transform = NO_TRANSFORM;
+    return *this;
+  }
+  Mesh(const Mesh &) = delete;
+  Mesh &operator=(const Mesh &) = delete;
+
+  // replace the geometry, keeping transform, shader and texture. The new data
+  // is written over the old while it fits the reserved ranges; otherwise the
+  // ranges grow geometrically, so sweeping through side counts reallocates
+  // only a few times.
+  template <typename Vertices>
+  void reshape(const Vertices &vertices, Span<const GLuint> indices) {
+    typedef typename std::remove_const<typename Vertices::value_type>::type
+        Vertex;
+    AABB box =
+        upload(Span<const Vertex>(vertices.data(), vertices.size()), indices);
+    show(allocation.range(), box);
+  }
+
+  // draw `range` from now on, e.g. geometry shared with other meshes. The
+  // mesh keeps its own allocation for the next reshape(). Without `box`
+  // the mesh is never culled.
+  void show(const ArenaRange &range, const AABB &box = AABB()) {
+    if (box.min != bounds.min || box.max != bounds.max)
+      transforms.reshape(transform);
+    bounds = box;
+    bounded = !box.empty();
+    vao = &range.page->vao;
+    index_type = range.page->index_type;
+    vertex_count = range.index_count;
+    first_index = range.first_index;
+    base_vertex = range.base_vertex;
+  }
+
+  // returns the bounds of the vertices
+  template <typename Vertex>
+  AABB upload(Span<const Vertex> vertices, Span<const GLuint> indices) {
+    PackedGeometry g = pack_geometry(vertices, indices);
+    if (!allocation.fits(*g.format, g.vertex_count, g.index_type,
+                         g.index_count)) {
+      GLuint vertex_capacity = g.vertex_count, index_capacity = g.index_count;
+      if (allocation.page) {
+        vertex_capacity =
+            std::max(vertex_capacity, 2 * allocation.vertex_capacity);
+        index_capacity =
+            std::max(index_capacity, 2 * allocation.index_capacity);
+      }
+      arena.release(allocation);
+      allocation = arena.allocate(*g.format, g.index_type, vertex_capacity,
+                                  index_capacity);
     }
-    delete vao;
-    delete vbo;
-    delete ebo;
+    arena.write(allocation, g.vertices, g.vertex_count, g.indices,
+                g.index_count);
+    return g.bounds;
   }
 
   void draw_element() {
     vao->bind();
-    glDrawElements(draw_mode, vertex_count, GL_UNSIGNED_INT, 0);
+    glDrawElementsBaseVertex(
+        draw_mode, vertex_count, index_type,
+        (void *)(size_t)(first_index * index_size(index_type)), base_vertex);
+    render_stats.draw_calls++;
+  }
+
+  // samplers default to unit 0, where the mesh texture lives
+  void bind_samplers() {
+    shader->use();
+    shader->setInt("models", MODELS_UNIT);
+    shader->setInt("draw_vertices", DRAW_VERTICES_UNIT);
+  }
+
+  // whether both meshes can go into one batched draw
+  bool batches_with(const Mesh &other) const {
+    return shader->ID == other.shader->ID &&
+           texture->ID == other.texture->ID && vao->ID == other.vao->ID &&
+           draw_mode == other.draw_mode;
+  }
+
+  glm::mat4 model() const { return transforms.model(transform); }
+
+  bool visible() const { return transforms.visible[transform]; }
+  void set_visible(bool visible) { transforms.visible[transform] = visible; }
+
+  // bounds in world space, empty when the mesh has none
+  AABB world_box() const {
+    return bounded ? transform_box(bounds, model()) : AABB();
+  }
+
+  // bounding sphere in world space; the model matrix does not scale
+  Sphere world_sphere() const {
+    Sphere s = bounding_sphere(bounds);
+    s.center = glm::vec3(model() * glm::vec4(s.center, 1.0f));
+    return s;
   }
 
   void set_camera(Camera &camera) {
     // pass projection matrix to shader (note that in this case it could
     // change every frame)
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),
-                                            camera.aspect_ratio, 0.1f, 100.0f);
-    shader->setMat4("projection", projection);
+    shader->setMat4("projection", camera.GetProjectionMatrix());
     shader->setMat4("view", camera.GetViewMatrix());
     // shader->setMat4("view", glm::lookAt(camera.Position, position,
     // camera.Up));
@@ -120,51 +460,40 @@ class Mesh {
   }
 
   void rotate(glm::vec3 vec, float angle = 1.0f) {
-    state.rotation = glm::rotate(state.rotation, glm::radians(angle), vec);
+    transforms.rotate(transform, vec, angle);
   }
 
+  // the auto rotation is advanced for every mesh at once by
+  // transforms.update()
   void render(Camera &camera) {
-    if (state.rotation_axis) {
-      glm::vec3 rot;
-      if (abs(state.rotation_axis) == 1) rot = BasisVectors::X;
-      if (abs(state.rotation_axis) == 2) rot = BasisVectors::Y;
-      if (abs(state.rotation_axis) == 3) rot = BasisVectors::Z;
-      state.rotation = glm::rotate(
-          state.rotation,
-          glm::radians((state.rotation_axis > 0 ? 1 : -1) * 1.0f), rot);
-    }
-    if (!state.visible) return;
-
-    texture->bind();
-    shader->use();
-
-    set_camera(camera);
+    if (visible()) draw(camera);
+  }
 
-    // calculate the model matrix for each object and pass it to shader before
-    // drawing
-    // make sure to initialize matrix to identity matrix first
-    glm::mat4 model = glm::translate(glm::mat4(1.0f), state.position);
-    model = model * state.rotation;
-    shader->setMat4("model", model);
+  // pipeline state key for the render queue; depth is the view space
+  // distance of the mesh origin
+  uint64_t sort_key(const glm::mat4 &view) {
+    glm::vec3 position = transforms.position(transform);
+    float depth = -(view * glm::vec4(position, 1.0f)).z;
+    return ::sort_key(shader->ID, texture->ID, vao->ID, depth, Z_FAR);
+  }
 
+  void draw(Camera &camera) {
+    bind(camera);
+    shader->setMat4("model", model());
     draw_element();
   }
 
-  void load_attributes(std::vector<std::tuple<GLint, GLenum>> attributes) {
-    GLsizei stride = 0;
-    for (auto &a : attributes)
-      stride += std::get<0>(a) * sizeof(std::get<1>(a));
-
-    unsigned long offset = 0;
+  // state shared by every draw of this mesh's batch
+  void bind(Camera &camera) {
+    // meshes are opaque and not culled
+    gl_state.set(GL_CULL_FACE, false);
+    gl_state.set(GL_BLEND, false);
+    gl_state.active_texture(GL_TEXTURE0);
+    texture->bind();
+    shader->use();
 
-    int index = 0;
-    for (auto &a : attributes) {
-      glVertexAttribPointer(index, std::get<0>(a), std::get<1>(a), GL_FALSE,
-                            stride, (void *)offset);
-      glEnableVertexAttribArray(index);
-      offset += std::get<0>(a) * sizeof(std::get<1>(a));
-      index++;
-    }
+    set_camera(camera);
+    vao->bind();
   }
 };
 
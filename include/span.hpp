@@ -0,0 +1,33 @@
+#pragma once
+
+// standard
+#include <cstddef>
+#include <utility>
+
+// Non-owning view of contiguous elements, a stand-in for C++20 std::span. A
+// function taking a Span accepts a vector, an array or a pointer and count
+// without copying the elements.
+template <typename T>
+class Span {
+ public:
+  typedef T value_type;
+
+  Span() : ptr(NULL), count(0) {}
+  Span(T *data, size_t size) : ptr(data), count(size) {}
+  template <size_t N>
+  Span(T (&array)[N]) : ptr(array), count(N) {}
+  // anything with data() and size(), e.g. std::vector and std::array
+  template <typename C, typename = decltype(std::declval<C &>().data())>
+  Span(C &&container) : ptr(container.data()), count(container.size()) {}
+
+  T *data() const { return ptr; }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  T &operator[](size_t i) const { return ptr[i]; }
+  T *begin() const { return ptr; }
+  T *end() const { return ptr + count; }
+
+ private:
+  T *ptr;
+  size_t count;
+};
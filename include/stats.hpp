@@ -0,0 +1,155 @@
+#pragma once
+
+// standard
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+// heap allocations made by any thread since startup. Counted by replacing the
+// global operator new, so like the rest of the engine this header must end up
+// in exactly one translation unit.
+std::atomic<uint64_t> heap_allocations{0};
+
+// Kept out of line: the compiler pairs calls to the replaced operator new
+// with calls to operator delete, and warns of a mismatch when it inlines a
+// delete down to the free() behind it (-Wmismatched-new-delete).
+#if defined(__GNUC__)
+#define HEAP_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define HEAP_NOINLINE __declspec(noinline)
+#else
+#define HEAP_NOINLINE
+#endif
+
+HEAP_NOINLINE void *operator new(std::size_t size) {
+  heap_allocations.fetch_add(1, std::memory_order_relaxed);
+  void *p = std::malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+HEAP_NOINLINE void operator delete(void *p) noexcept { std::free(p); }
+HEAP_NOINLINE void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+// arrays go through the same pair
+void *operator new[](std::size_t size) { return operator new(size); }
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete[](void *p, std::size_t) noexcept { operator delete(p); }
+
+// counters of the render work done in one frame
+struct RenderStats {
+  uint64_t draw_calls = 0;
+  uint64_t program_binds = 0;
+  uint64_t texture_binds = 0;
+  uint64_t vao_binds = 0;
+  uint64_t uniform_uploads = 0;
+  uint64_t uniform_lookups = 0;  // glGetUniformLocation calls
+  uint64_t buffer_bytes = 0;     // bytes uploaded into buffer objects
+  uint64_t allocations = 0;      // heap allocations
+  uint64_t state_skipped = 0;    // redundant GL state changes filtered out
+  uint64_t shapes_tested = 0;    // visible shapes in frustum BVH leaves
+  uint64_t shapes_culled = 0;    // of those, the ones outside it
+  uint64_t gpu_instances = 0;    // instances culled by the compute pass
+  uint64_t gpu_drawn = 0;        // of those, drawn; frames late
+
+  static const char *csv_header() {
+    return "frame,draw_calls,program_binds,texture_binds,vao_binds,"
+           "uniform_uploads,uniform_lookups,buffer_bytes,allocations,"
+           "state_skipped,shapes_tested,shapes_culled,gpu_instances,"
+           "gpu_drawn";
+  }
+
+  void write_csv(std::ostream &out, int frame) const {
+    out << frame << ',' << draw_calls << ',' << program_binds << ','
+        << texture_binds << ',' << vao_binds << ',' << uniform_uploads << ','
+        << uniform_lookups << ',' << buffer_bytes << ',' << allocations
+        << ',' << state_skipped << ',' << shapes_tested << ','
+        << shapes_culled << ',' << gpu_instances << ',' << gpu_drawn
+        << '\n';
+  }
+
+  std::vector<std::string> report() const {
+    char line[128];
+    std::vector<std::string> lines;
+    snprintf(line, sizeof(line), "draws %llu  programs %llu  textures %llu",
+             (unsigned long long)draw_calls,
+             (unsigned long long)program_binds,
+             (unsigned long long)texture_binds);
+    lines.push_back(line);
+    snprintf(line, sizeof(line), "vaos %llu  uniforms %llu  lookups %llu",
+             (unsigned long long)vao_binds,
+             (unsigned long long)uniform_uploads,
+             (unsigned long long)uniform_lookups);
+    lines.push_back(line);
+    snprintf(line, sizeof(line), "uploaded %llu B  allocations %llu",
+             (unsigned long long)buffer_bytes,
+             (unsigned long long)allocations);
+    lines.push_back(line);
+    snprintf(line, sizeof(line), "state changes skipped %llu",
+             (unsigned long long)state_skipped);
+    lines.push_back(line);
+    snprintf(line, sizeof(line), "culled %llu of %llu shapes",
+             (unsigned long long)shapes_culled,
+             (unsigned long long)shapes_tested);
+    lines.push_back(line);
+    if (gpu_instances) {
+      snprintf(line, sizeof(line), "gpu drew %llu of %llu instances",
+               (unsigned long long)gpu_drawn,
+               (unsigned long long)gpu_instances);
+      lines.push_back(line);
+    }
+    return lines;
+  }
+};
+
+// counters of the frame in progress; the engine classes add to it directly
+RenderStats render_stats;
+
+// Resets the counters every frame, keeps the last complete frame and
+// optionally appends each frame as a CSV row.
+class StatsRecorder {
+ public:
+  RenderStats last;  // counters of the previous complete frame
+  int frame = 0;
+
+  ~StatsRecorder() { stop_log(); }
+
+  void begin_frame() {
+    render_stats = RenderStats();
+    allocations_start = heap_allocations.load(std::memory_order_relaxed);
+  }
+
+  void end_frame() {
+    render_stats.allocations =
+        heap_allocations.load(std::memory_order_relaxed) - allocations_start;
+    last = render_stats;
+    if (csv.is_open()) last.write_csv(csv, frame);
+    frame++;
+  }
+
+  bool logging() const { return csv.is_open(); }
+
+  // append to `path`, starting it with the header when it is new or empty
+  void start_log(std::string path) {
+    csv.open(path.c_str(), std::ios::out | std::ios::app);
+    if (!csv) {
+      std::fprintf(stderr, "Failed to open stats log %s\n", path.c_str());
+      return;
+    }
+    csv.seekp(0, std::ios::end);
+    if (csv.tellp() == 0) csv << RenderStats::csv_header() << '\n';
+  }
+
+  void stop_log() {
+    if (csv.is_open()) csv.close();
+  }
+
+ private:
+  uint64_t allocations_start = 0;
+  std::ofstream csv;
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+// standard
+#include <algorithm>
+#include <cstring>
+
+// glad
+#include <glad/glad.h>
+
+// helpers
+#include "deletion.hpp"
+#include "glstate.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+// frames that may be in flight at once, each with its own region of the ring
+const int STREAM_FRAMES = 3;
+// bytes of each frame's region
+const GLsizeiptr STREAM_REGION_SIZE = 1 << 20;
+
+// a piece of the stream buffer written this frame
+struct StreamSlice {
+  void *data;
+  GLuint buffer;
+  GLintptr offset;
+};
+
+// Ring buffer for data that changes every frame: text quads, batch model
+// matrices and draw commands. Uploads are a memcpy into mapped memory.
+//
+// With GL 4.4 the buffer is mapped once, persistently and coherently, and
+// split into one region per frame in flight. A fence guards each region, so
+// the CPU only waits if the GPU falls STREAM_FRAMES frames behind.
+//
+// On GL 3.3 each slice is mapped unsynchronized, which is safe since slices
+// never overlap until the buffer wraps, and the buffer is orphaned when it
+// wraps. Callers must flush() before drawing from the written slices.
+class StreamBuffer {
+ public:
+  GLuint ID = 0;
+  bool persistent = false;
+
+  void init(GLsizeiptr region_size = STREAM_REGION_SIZE) {
+#ifdef GL_VERSION_4_4
+    persistent = GLAD_GL_VERSION_4_4;
+#endif
+    create(region_size);
+  }
+
+  // must run while the GL context is still alive
+  void destroy() {
+    if (!ID) return;
+    for (auto &f : fences)
+      if (f) glDeleteSync(f), f = 0;
+    release(ID, mapped);
+    ID = 0;
+    mapped = NULL;
+  }
+
+  // wait until the GPU is done with this frame's region
+  void begin_frame() {
+    if (!persistent) return;
+    region = frame % STREAM_FRAMES;
+    cursor = region * region_size;
+    GLsync &fence = fences[region];
+    if (fence) {
+      TraceScope trace("stream wait", "gl");
+      glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, ~0ull);
+      glDeleteSync(fence);
+      fence = 0;
+    }
+  }
+
+  void end_frame() {
+    flush();
+    if (persistent)
+      fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame++;
+  }
+
+  // reserve `size` bytes whose offset is a multiple of `align`
+  StreamSlice alloc(GLsizeiptr size, GLsizeiptr align = 16) {
+    flush();
+    GLintptr offset = (cursor + align - 1) / align * align;
+    if (persistent) {
+      GLintptr end = (region + 1) * region_size;
+      if (offset + size > end) {
+        // this frame outgrew its region; earlier slices stay valid in the
+        // old buffer, which the deletion queue frees once the GPU is done
+        // with it
+        TraceScope trace("stream grow", "gl");
+        // the old name is not given back to GL yet, so no later grow gets
+        // it again and users that compare buffer names always see a change
+        GLuint old = ID;
+        void *old_mapped = mapped;
+        create(std::max(region_size * 2, size + align));
+        unmap(old, old_mapped);
+        deletion_queue.retire_buffer(old);
+        for (auto &f : fences)
+          if (f) glDeleteSync(f), f = 0;
+        region = frame % STREAM_FRAMES;
+        offset = region * region_size;
+      }
+      cursor = offset + size;
+      render_stats.buffer_bytes += size;
+      return {(char *)mapped + offset, ID, offset};
+    }
+
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, ID);
+    if (offset + size > capacity) {
+      if (size > capacity) capacity = size;
+      // orphan: the driver hands out fresh storage and keeps the old one
+      // alive for the draws still using it
+      glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+      offset = 0;
+    }
+    cursor = offset + size;
+    mapped = glMapBufferRange(GL_ARRAY_BUFFER, offset, size,
+                              GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+                                  GL_MAP_INVALIDATE_RANGE_BIT);
+    render_stats.buffer_bytes += size;
+    return {mapped, ID, offset};
+  }
+
+  // copy `size` bytes in and return where they went
+  StreamSlice write(const void *data, GLsizeiptr size, GLsizeiptr align = 16) {
+    StreamSlice slice = alloc(size, align);
+    std::memcpy(slice.data, data, size);
+    return slice;
+  }
+
+  // make the slices written so far visible to draws; a no-op when persistent
+  void flush() {
+    if (persistent || !mapped) return;
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, ID);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    mapped = NULL;
+  }
+
+ private:
+  GLsizeiptr region_size = 0;
+  GLsizeiptr capacity = 0;
+  GLintptr cursor = 0;
+  int region = 0;
+  int frame = 0;
+  void *mapped = NULL;
+  GLsync fences[STREAM_FRAMES] = {};
+
+  void unmap(GLuint buffer, void *mapping) {
+    if (!mapping) return;
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, buffer);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+
+  void release(GLuint buffer, void *mapping) {
+    unmap(buffer, mapping);
+    glDeleteBuffers(1, &buffer);
+    gl_state.forget_buffer(buffer);
+  }
+
+  void create(GLsizeiptr size) {
+    region_size = size;
+    capacity = size * STREAM_FRAMES;
+    cursor = 0;
+    glGenBuffers(1, &ID);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, ID);
+#ifdef GL_VERSION_4_4
+    if (persistent) {
+      GLbitfield flags =
+          GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      glBufferStorage(GL_ARRAY_BUFFER, capacity, NULL, flags);
+      mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, capacity, flags);
+      return;
+    }
+#endif
+    glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+  }
+};
+
+StreamBuffer stream;
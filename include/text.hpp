@@ -1,6 +1,7 @@
 #pragma once
 
 // standard
+#include <cstring>
 #include <map>
 
 // glm
@@ -16,7 +17,11 @@
 #include FT_FREETYPE_H
 
 // helper
+#include <glstate.hpp>
 #include <shader.hpp>
+#include <stats.hpp>
+#include <stream.hpp>
+#include <trace.hpp>
 #include <utils.hpp>
 
 /// Holds all state information relevant to a character as loaded using FreeType
@@ -29,11 +34,13 @@ struct Character {
 
 struct Font {
   std::map<GLchar, Character> glyphs;
-  GLuint VAO, VBO;
+  GLuint VAO;
+  GLuint stream_buffer = 0;  // buffer the VAO currently reads quads from
   Shader *shader;
 };
 
 Font compile_font(std::string font_name, int WIDTH, int HEIGHT) {
+  TraceScope trace("compile_font", "text");
   Font f;
   // compile and setup the shader
   // f.shader = new Shader("src/text.vs", "src/text.fs");
@@ -88,7 +95,7 @@ Font compile_font(std::string font_name, int WIDTH, int HEIGHT) {
       // generate texture
       unsigned int texture;
       glGenTextures(1, &texture);
-      glBindTexture(GL_TEXTURE_2D, texture);
+      gl_state.bind_texture(GL_TEXTURE_2D, texture);
       glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, face->glyph->bitmap.width,
                    face->glyph->bitmap.rows, 0, GL_RED, GL_UNSIGNED_BYTE,
                    face->glyph->bitmap.buffer);
@@ -104,82 +111,89 @@ Font compile_font(std::string font_name, int WIDTH, int HEIGHT) {
           glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
           static_cast<unsigned int>(face->glyph->advance.x)};
     }
-    glBindTexture(GL_TEXTURE_2D, 0);
+    gl_state.bind_texture(GL_TEXTURE_2D, 0);
   }
   // destroy FreeType once we're finished
   FT_Done_Face(face);
   FT_Done_FreeType(ft);
 
-  // configure VAO/VBO for texture quads
+  // configure VAO for texture quads; they are read from the stream buffer
   glGenVertexArrays(1, &f.VAO);
-  glGenBuffers(1, &f.VBO);
-  glBindVertexArray(f.VAO);
-  glBindBuffer(GL_ARRAY_BUFFER, f.VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
+  gl_state.bind_vertex_array(f.VAO);
   glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
+  gl_state.bind_vertex_array(0);
 
   return f;
 }
 
+// text is drawn with culling and blending on; everything else sets the state
+// it needs itself, so consecutive text calls leave it untouched
 void font_blend_enable() {
-  glEnable(GL_CULL_FACE);
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  gl_state.set(GL_CULL_FACE, true);
+  gl_state.set(GL_BLEND, true);
+  gl_state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
 void font_blend_disable() {
-  glDisable(GL_CULL_FACE);
-  glDisable(GL_BLEND);
+  gl_state.set(GL_CULL_FACE, false);
+  gl_state.set(GL_BLEND, false);
 }
 
-// render line of text
+// render line of text. All glyph quads go into the stream buffer at once,
+// then each glyph is drawn from its part of the slice.
 void RenderText(std::string text, float x, float y, float scale,
                 glm::vec3 color, Font &f) {
+  if (text.empty()) return;
+  const int QUAD = 6 * 4;  // floats per glyph quad
+
+  StreamSlice slice = stream.alloc(text.size() * QUAD * sizeof(float));
+  {
+    TraceScope trace("glyph upload", "gl");
+    float *vertices = (float *)slice.data;
+    for (auto &c : text) {
+      Character &ch = f.glyphs[c];
+
+      float xpos = x + ch.Bearing.x * scale;
+      float ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
+
+      float w = ch.Size.x * scale;
+      float h = ch.Size.y * scale;
+      float quad[QUAD] = {xpos,     ypos + h, 0.0f, 0.0f,  // top left
+                          xpos,     ypos,     0.0f, 1.0f,  // bottom left
+                          xpos + w, ypos,     1.0f, 1.0f,  // bottom right
+                          xpos,     ypos + h, 0.0f, 0.0f,  // top left
+                          xpos + w, ypos,     1.0f, 1.0f,  // bottom right
+                          xpos + w, ypos + h, 1.0f, 0.0f};  // top right
+      std::memcpy(vertices, quad, sizeof(quad));
+      vertices += QUAD;
+      // now advance cursors for next glyph (note that advance is number of
+      // 1/64 pixels)
+      x += (ch.Advance >> 6) *
+           scale;  // bitshift by 6 to get value in pixels (2^6 = 64 (divide
+                   // amount of 1/64th pixels by 64 to get amount of pixels))
+    }
+    stream.flush();
+  }
+
   font_blend_enable();
   // activate corresponding render state
   f.shader->use();
-  glUniform3f(glGetUniformLocation(f.shader->ID, "textColor"), color.x, color.y,
-              color.z);
-  glActiveTexture(GL_TEXTURE0);
-  glBindVertexArray(f.VAO);
+  f.shader->setVec3("textColor", color);
+  gl_state.active_texture(GL_TEXTURE0);
+  gl_state.bind_vertex_array(f.VAO);
+  // the stream buffer is replaced when it grows
+  if (f.stream_buffer != slice.buffer) {
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, slice.buffer);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
+    f.stream_buffer = slice.buffer;
+  }
 
-  // iterate through all characters
+  // render glyph textures over their quads
+  GLint first = slice.offset / (4 * sizeof(float));
   for (auto &c : text) {
-    Character ch = f.glyphs[c];
-
-    float xpos = x + ch.Bearing.x * scale;
-    float ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
-
-    float w = ch.Size.x * scale;
-    float h = ch.Size.y * scale;
-    // update VBO for each character
-    float vertices[6][4] = {
-        {xpos, ypos + h, 0.0f, 0.0f},    {xpos, ypos, 0.0f, 1.0f},
-        {xpos + w, ypos, 1.0f, 1.0f},
-
-        {xpos, ypos + h, 0.0f, 0.0f},    {xpos + w, ypos, 1.0f, 1.0f},
-        {xpos + w, ypos + h, 1.0f, 0.0f}};
-    // render glyph texture over quad
-    glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-    // update content of VBO memory
-    glBindBuffer(GL_ARRAY_BUFFER, f.VBO);
-    glBufferSubData(
-        GL_ARRAY_BUFFER, 0, sizeof(vertices),
-        vertices);  // be sure to use glBufferSubData and not glBufferData
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    // render quad
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    // now advance cursors for next glyph (note that advance is number of 1/64
-    // pixels)
-    x += (ch.Advance >> 6) *
-         scale;  // bitshift by 6 to get value in pixels (2^6 = 64 (divide
-                 // amount of 1/64th pixels by 64 to get amount of pixels))
+    gl_state.bind_texture(GL_TEXTURE_2D, f.glyphs[c].TextureID);
+    glDrawArrays(GL_TRIANGLES, first, 6);
+    render_stats.draw_calls++;
+    first += 6;
   }
-  glBindVertexArray(0);
-  glBindTexture(GL_TEXTURE_2D, 0);
-  font_blend_disable();
 }
@@ -0,0 +1,199 @@
+#pragma once
+
+// standard
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// events each thread can hold before the writer drains them; when a buffer is
+// full new events are dropped and counted
+const uint32_t TRACE_BUFFER_EVENTS = 1 << 14;
+
+// a finished zone; name and category must be string literals, since only the
+// pointers are stored
+struct TraceEvent {
+  const char *name;
+  const char *category;
+  double start;  // microseconds since the tracer was created
+  double duration;
+};
+
+// single-producer single-consumer ring: the owning thread pushes, the writer
+// thread pops. No locks on either side.
+struct TraceBuffer {
+  uint32_t tid;
+  // both guarded by Tracer::buffers_mutex
+  std::string thread_name;
+  bool name_written = false;  // thread_name metadata is in the file
+  std::atomic<uint32_t> head{0};  // next slot to write, owned by the producer
+  std::atomic<uint32_t> tail{0};  // next slot to read, owned by the consumer
+  TraceEvent events[TRACE_BUFFER_EVENTS];
+
+  bool push(const TraceEvent &e) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == TRACE_BUFFER_EVENTS)
+      return false;
+    events[h % TRACE_BUFFER_EVENTS] = e;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  template <typename F>
+  void drain(F write) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    uint32_t h = head.load(std::memory_order_acquire);
+    for (; t != h; t++) write(events[t % TRACE_BUFFER_EVENTS]);
+    tail.store(t, std::memory_order_release);
+  }
+};
+
+// Records zones as Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+// Events go into per-thread lock-free buffers; a background thread drains them
+// into the file while recording.
+class Tracer {
+ public:
+  typedef std::chrono::steady_clock clock;
+  std::atomic<int> dropped{0};
+
+  Tracer() : epoch(clock::now()) {}
+  ~Tracer() { stop(); }
+
+  bool recording() const { return active.load(std::memory_order_relaxed); }
+
+  void start(std::string path) {
+    if (recording()) return;
+    file = fopen(path.c_str(), "w");
+    if (!file) {
+      std::fprintf(stderr, "Failed to open trace file %s\n", path.c_str());
+      return;
+    }
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    first = true;
+    // discard events left over from a previous recording
+    {
+      std::lock_guard<std::mutex> lock(buffers_mutex);
+      for (auto &b : buffers) {
+        b->drain([](const TraceEvent &) {});
+        b->name_written = false;
+      }
+    }
+    running = true;
+    active = true;
+    writer = std::thread([this]() { write_loop(); });
+  }
+
+  void stop() {
+    if (!recording()) return;
+    active = false;
+    running = false;
+    writer.join();
+    flush();
+    std::fprintf(file, "\n]}\n");
+    fclose(file);
+    file = NULL;
+  }
+
+  // name the calling thread in the trace; a name set while recording is
+  // written with the next flush
+  void name_thread(std::string name) {
+    TraceBuffer *b = buffer();
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    b->thread_name = name;
+    b->name_written = false;
+  }
+
+  // microseconds since the tracer was created
+  double at(clock::time_point t) const {
+    return std::chrono::duration<double, std::micro>(t - epoch).count();
+  }
+  double now() const { return at(clock::now()); }
+
+  void record(const char *name, const char *category, double start,
+              double end) {
+    if (!recording()) return;
+    if (!buffer()->push({name, category, start, end - start})) dropped++;
+  }
+
+ private:
+  clock::time_point epoch;
+  std::atomic<bool> active{false};
+  std::atomic<bool> running{false};
+  std::thread writer;
+  FILE *file = NULL;
+  bool first = true;
+
+  // only taken to register or name a thread, or to flush
+  std::mutex buffers_mutex;
+  std::vector<std::unique_ptr<TraceBuffer>> buffers;
+
+  TraceBuffer *buffer() {
+    thread_local TraceBuffer *mine = NULL;
+    if (!mine) {
+      std::lock_guard<std::mutex> lock(buffers_mutex);
+      buffers.emplace_back(new TraceBuffer());
+      mine = buffers.back().get();
+      mine->tid = buffers.size();
+      mine->thread_name = "thread " + std::to_string(mine->tid);
+    }
+    return mine;
+  }
+
+  void write_loop() {
+    while (running) {
+      flush();
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  void flush() {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    for (auto &b : buffers) {
+      if (b->name_written) continue;
+      b->name_written = true;
+      separator();
+      std::fprintf(file,
+                   "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                   "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                   b->tid, b->thread_name.c_str());
+    }
+    for (auto &b : buffers) {
+      uint32_t tid = b->tid;
+      b->drain([this, tid](const TraceEvent &e) {
+        separator();
+        std::fprintf(file,
+                     "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                     "\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                     e.name, e.category, tid, e.start, e.duration);
+      });
+    }
+    fflush(file);
+  }
+
+  void separator() {
+    if (!first) std::fputs(",\n", file);
+    first = false;
+  }
+};
+
+Tracer tracer;
+
+// scoped trace event; only recorded if tracing was on when the scope began
+struct TraceScope {
+  const char *name;
+  const char *category;
+  double start;
+  bool on;
+  TraceScope(const char *name, const char *category)
+      : name(name), category(category), on(tracer.recording()) {
+    if (on) start = tracer.now();
+  }
+  ~TraceScope() {
+    if (on) tracer.record(name, category, start, tracer.now());
+  }
+};
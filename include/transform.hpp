@@ -0,0 +1,309 @@
+#pragma once
+
+// standard
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// simd
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// glm
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// helpers
+#include "pool.hpp"
+
+// a slot of the TransformStore; slots never move, so a handle stays valid
+// until it is removed
+typedef uint32_t TransformHandle;
+const TransformHandle NO_TRANSFORM = UINT32_MAX;
+
+// Multiplies `count` quaternions (w, x, y, z) by the turn of half-angle
+// sine `s` and cosine `c` around the axes (ax, ay, az), unit or zero, and
+// renormalizes them, as many per step as the vectors hold.
+void spin_kernel(float c, float s, const float *ax, const float *ay,
+                 const float *az, float *w, float *x, float *y, float *z,
+                 size_t count) {
+#if defined(__AVX__)
+#define SPIN_SET(v) _mm256_set1_ps(v)
+#define SPIN_MUL _mm256_mul_ps
+#define SPIN_ADD _mm256_add_ps
+#define SPIN_SUB _mm256_sub_ps
+#define SPIN_DIV _mm256_div_ps
+#define SPIN_SQRT _mm256_sqrt_ps
+  const size_t width = 8;
+  typedef __m256 lane;
+  auto load = [](const float *p) { return _mm256_loadu_ps(p); };
+  auto store = [](float *p, lane v) { _mm256_storeu_ps(p, v); };
+#elif defined(__SSE2__)
+#define SPIN_SET(v) _mm_set1_ps(v)
+#define SPIN_MUL _mm_mul_ps
+#define SPIN_ADD _mm_add_ps
+#define SPIN_SUB _mm_sub_ps
+#define SPIN_DIV _mm_div_ps
+#define SPIN_SQRT _mm_sqrt_ps
+  const size_t width = 4;
+  typedef __m128 lane;
+  auto load = [](const float *p) { return _mm_loadu_ps(p); };
+  auto store = [](float *p, lane v) { _mm_storeu_ps(p, v); };
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define SPIN_SET(v) vdupq_n_f32(v)
+#define SPIN_MUL vmulq_f32
+#define SPIN_ADD vaddq_f32
+#define SPIN_SUB vsubq_f32
+#define SPIN_DIV vdivq_f32
+#define SPIN_SQRT vsqrtq_f32
+  const size_t width = 4;
+  typedef float32x4_t lane;
+  auto load = [](const float *p) { return vld1q_f32(p); };
+  auto store = [](float *p, lane v) { vst1q_f32(p, v); };
+#else
+#define SPIN_SET(v) (v)
+#define SPIN_MUL(a, b) ((a) * (b))
+#define SPIN_ADD(a, b) ((a) + (b))
+#define SPIN_SUB(a, b) ((a) - (b))
+#define SPIN_DIV(a, b) ((a) / (b))
+#define SPIN_SQRT std::sqrt
+  const size_t width = 1;
+  typedef float lane;
+  auto load = [](const float *p) { return *p; };
+  auto store = [](float *p, lane v) { *p = v; };
+#endif
+  // the turn is (cos, sin * axis) for unit axes and the identity for zero
+  // ones: its scalar part is 1 + (cos - 1) |axis|^2
+  auto turn = [&](size_t i) {
+    lane ux = load(ax + i), uy = load(ay + i), uz = load(az + i);
+    lane u2 = SPIN_ADD(SPIN_ADD(SPIN_MUL(ux, ux), SPIN_MUL(uy, uy)),
+                       SPIN_MUL(uz, uz));
+    lane tw = SPIN_ADD(SPIN_SET(1.0f), SPIN_MUL(u2, SPIN_SET(c - 1.0f)));
+    lane tx = SPIN_MUL(ux, SPIN_SET(s)), ty = SPIN_MUL(uy, SPIN_SET(s)),
+         tz = SPIN_MUL(uz, SPIN_SET(s));
+    lane w0 = load(w + i), x0 = load(x + i), y0 = load(y + i),
+         z0 = load(z + i);
+    // (w0, v0) (tw, t) = (w0 tw - v0.t, w0 t + tw v0 + v0 x t)
+    lane w1 = SPIN_SUB(SPIN_MUL(w0, tw),
+                       SPIN_ADD(SPIN_ADD(SPIN_MUL(x0, tx), SPIN_MUL(y0, ty)),
+                                SPIN_MUL(z0, tz)));
+    lane x1 = SPIN_ADD(SPIN_ADD(SPIN_MUL(x0, tw), SPIN_MUL(w0, tx)),
+                       SPIN_SUB(SPIN_MUL(y0, tz), SPIN_MUL(z0, ty)));
+    lane y1 = SPIN_ADD(SPIN_ADD(SPIN_MUL(y0, tw), SPIN_MUL(w0, ty)),
+                       SPIN_SUB(SPIN_MUL(z0, tx), SPIN_MUL(x0, tz)));
+    lane z1 = SPIN_ADD(SPIN_ADD(SPIN_MUL(z0, tw), SPIN_MUL(w0, tz)),
+                       SPIN_SUB(SPIN_MUL(x0, ty), SPIN_MUL(y0, tx)));
+    lane n = SPIN_DIV(
+        SPIN_SET(1.0f),
+        SPIN_SQRT(SPIN_ADD(SPIN_ADD(SPIN_MUL(w1, w1), SPIN_MUL(x1, x1)),
+                           SPIN_ADD(SPIN_MUL(y1, y1), SPIN_MUL(z1, z1)))));
+    store(w + i, SPIN_MUL(w1, n));
+    store(x + i, SPIN_MUL(x1, n));
+    store(y + i, SPIN_MUL(y1, n));
+    store(z + i, SPIN_MUL(z1, n));
+  };
+  size_t i = 0;
+  for (; i + width <= count; i += width) turn(i);
+#undef SPIN_SET
+#undef SPIN_MUL
+#undef SPIN_ADD
+#undef SPIN_SUB
+#undef SPIN_DIV
+#undef SPIN_SQRT
+  // the slots past the last full vector
+  for (; i < count; i++) {
+    float u2 = ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i];
+    glm::quat t(1.0f + (c - 1.0f) * u2, s * ax[i], s * ay[i], s * az[i]);
+    glm::quat q = glm::normalize(glm::quat(w[i], x[i], y[i], z[i]) * t);
+    w[i] = q.w;
+    x[i] = q.x;
+    y[i] = q.y;
+    z[i] = q.z;
+  }
+}
+
+// Placement and visibility of every shape, one array per component. Loops
+// over all shapes, like the auto rotation in update(), walk the arrays in
+// order, without touching the meshes, and vectorize. Removed slots are
+// hidden and are reused by the next add().
+class TransformStore {
+ public:
+  std::vector<float> x, y, z;         // position
+  std::vector<float> qx, qy, qz, qw;  // rotation quaternion
+  // auto rotation axis, zero for none; see spin()
+  std::vector<float> spin_x, spin_y, spin_z;
+  std::vector<uint8_t> spinning;
+  std::vector<uint8_t> visible;
+  // slots whose mesh changed its bounds, each once until clear_reshaped()
+  std::vector<TransformHandle> reshaped;
+
+  TransformHandle add() {
+    TransformHandle h;
+    if (!free_slots.empty()) {
+      h = free_slots.back();
+      free_slots.pop_back();
+    } else {
+      h = size();
+      for (auto a : {&x, &y, &z, &qx, &qy, &qz, &qw, &spin_x, &spin_y,
+                     &spin_z})
+        a->push_back(0.0f);
+      spinning.push_back(0);
+      visible.push_back(0);
+      reshaped_flags.push_back(0);
+      for (auto &log : logs) log.flags.push_back(0);
+    }
+    reset(h);
+    return h;
+  }
+
+  void remove(TransformHandle h) {
+    if (h == NO_TRANSFORM) return;
+    spin(h, 0);
+    visible[h] = 0;
+    free_slots.push_back(h);
+  }
+
+  // slots, removed ones included
+  size_t size() const { return x.size(); }
+
+  // at the origin, unrotated, still and visible
+  void reset(TransformHandle h) {
+    set_position(h, glm::vec3(0.0f));
+    set_rotation(h, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    spin(h, 0);
+    visible[h] = 1;
+  }
+
+  glm::vec3 position(TransformHandle h) const {
+    return glm::vec3(x[h], y[h], z[h]);
+  }
+  void set_position(TransformHandle h, const glm::vec3 &p) {
+    x[h] = p.x;
+    y[h] = p.y;
+    z[h] = p.z;
+    mark(h);
+  }
+
+  glm::quat rotation(TransformHandle h) const {
+    return glm::quat(qw[h], qx[h], qy[h], qz[h]);
+  }
+  void set_rotation(TransformHandle h, const glm::quat &q) {
+    qx[h] = q.x;
+    qy[h] = q.y;
+    qz[h] = q.z;
+    qw[h] = q.w;
+    mark(h);
+  }
+
+  // turn by `angle` degrees around `vec` in model space
+  void rotate(TransformHandle h, const glm::vec3 &vec, float angle) {
+    set_rotation(h, glm::normalize(rotation(h) *
+                                   glm::angleAxis(glm::radians(angle), vec)));
+  }
+
+  glm::mat4 model(TransformHandle h) const {
+    glm::mat4 m = glm::mat4_cast(rotation(h));
+    m[3] = glm::vec4(position(h), 1.0f);
+    return m;
+  }
+
+  // move every slot by `step`
+  void translate_all(const glm::vec3 &step) {
+    for (size_t i = 0; i < size(); i++) {
+      x[i] += step.x;
+      y[i] += step.y;
+      z[i] += step.z;
+      mark(i);
+    }
+  }
+
+  // turn every slot by `angle` degrees around `vec`
+  void rotate_all(const glm::vec3 &vec, float angle) {
+    glm::quat turn = glm::angleAxis(glm::radians(angle), vec);
+    for (size_t i = 0; i < size(); i++)
+      set_rotation(i, glm::normalize(rotation(i) * turn));
+  }
+
+  // auto rotate around X, Y or Z for `axis` 1, 2 or 3, backwards when it is
+  // negative, and stop for 0
+  void spin(TransformHandle h, int axis) {
+    float sign = axis < 0 ? -1.0f : 1.0f;
+    spin_x[h] = std::abs(axis) == 1 ? sign : 0.0f;
+    spin_y[h] = std::abs(axis) == 2 ? sign : 0.0f;
+    spin_z[h] = std::abs(axis) == 3 ? sign : 0.0f;
+    spinning[h] = axis != 0;
+  }
+  void spin_all(int axis) {
+    for (size_t i = 0; i < size(); i++) spin(i, axis);
+  }
+
+  // Advance the auto rotations by a degree: each quaternion is multiplied by
+  // a turn around its spin axis, which is zero for slots that do not spin,
+  // and renormalized. The spinning slots are logged as moved.
+  void update() {
+    const float c = std::cos(glm::radians(0.5f));
+    const float s = std::sin(glm::radians(0.5f));
+    thread_pool.parallel_for(size(), 1 << 14, [&](size_t begin, size_t end) {
+      spin_kernel(c, s, spin_x.data() + begin, spin_y.data() + begin,
+                  spin_z.data() + begin, qw.data() + begin,
+                  qx.data() + begin, qy.data() + begin, qz.data() + begin,
+                  end - begin);
+    });
+    for (size_t i = 0; i < size(); i++)
+      if (spinning[i]) mark(i);
+  }
+
+  // Open a log of the slots moved or turned from now on. Each consumer of
+  // moves, like the BVH or the GPU culler, watches with its own log, so
+  // clearing it does not hide moves from the others.
+  int watch() {
+    logs.emplace_back();
+    logs.back().flags.assign(size(), 0);
+    return logs.size() - 1;
+  }
+  // the slots moved since clear_moved(log), each once
+  const std::vector<TransformHandle> &moved(int log) const {
+    return logs[log].slots;
+  }
+  void clear_moved(int log) {
+    MoveLog &l = logs[log];
+    for (TransformHandle h : l.slots) l.flags[h] = 0;
+    l.slots.clear();
+  }
+
+  // the mesh in slot `h` changed its bounds
+  void reshape(TransformHandle h) {
+    if (reshaped_flags[h]) return;
+    reshaped_flags[h] = 1;
+    reshaped.push_back(h);
+  }
+  void clear_reshaped() {
+    for (TransformHandle h : reshaped) reshaped_flags[h] = 0;
+    reshaped.clear();
+  }
+
+ private:
+  struct MoveLog {
+    std::vector<uint8_t> flags;  // by slot, set while it is in `slots`
+    std::vector<TransformHandle> slots;
+  };
+  std::vector<MoveLog> logs;
+  std::vector<uint8_t> reshaped_flags;
+  std::vector<TransformHandle> free_slots;
+
+  void mark(TransformHandle h) {
+    for (auto &log : logs)
+      if (!log.flags[h]) {
+        log.flags[h] = 1;
+        log.slots.push_back(h);
+      }
+  }
+};
+
+TransformStore transforms;
@@ -0,0 +1,162 @@
+#pragma once
+
+// standard
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// glad
+#include <glad/glad.h>
+
+// 16-bit float as stored in vertex buffers
+struct Half {
+  GLushort bits;
+};
+
+// round to the nearest half, ties to even
+Half to_half(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  GLushort sign = (x >> 16) & 0x8000;
+  int exp = int((x >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = x & 0x7fffff;
+  if (((x >> 23) & 0xff) == 0xff)  // inf and nan
+    return {GLushort(sign | 0x7c00 | (mantissa ? 0x200 : 0))};
+  if (exp >= 31) return {GLushort(sign | 0x7c00)};
+  uint32_t h, rest, halfway;
+  if (exp <= 0) {  // subnormal half
+    if (exp < -10) return {sign};
+    mantissa |= 0x800000;
+    int shift = 14 - exp;
+    h = mantissa >> shift;
+    rest = mantissa & ((1u << shift) - 1);
+    halfway = 1u << (shift - 1);
+  } else {
+    h = uint32_t(exp) << 10 | mantissa >> 13;
+    rest = mantissa & 0x1fff;
+    halfway = 0x1000;
+  }
+  // a carry out of the mantissa correctly bumps the exponent
+  if (rest > halfway || (rest == halfway && (h & 1))) h++;
+  return {GLushort(sign | h)};
+}
+
+// [0, 1] to an unsigned normalized byte
+GLubyte to_unorm8(float f) {
+  if (f < 0.0f) f = 0.0f;
+  if (f > 1.0f) f = 1.0f;
+  return GLubyte(f * 255.0f + 0.5f);
+}
+
+// GL enum of a vertex component type
+template <typename T>
+struct GLType;
+template <>
+struct GLType<GLfloat> {
+  static constexpr GLenum value = GL_FLOAT;
+};
+template <>
+struct GLType<GLbyte> {
+  static constexpr GLenum value = GL_BYTE;
+};
+template <>
+struct GLType<GLubyte> {
+  static constexpr GLenum value = GL_UNSIGNED_BYTE;
+};
+template <>
+struct GLType<GLshort> {
+  static constexpr GLenum value = GL_SHORT;
+};
+template <>
+struct GLType<GLushort> {
+  static constexpr GLenum value = GL_UNSIGNED_SHORT;
+};
+template <>
+struct GLType<Half> {
+  static constexpr GLenum value = GL_HALF_FLOAT;
+};
+
+// one vertex attribute: N components of type T, optionally normalized from
+// an integer type to [-1, 1] or [0, 1]
+template <GLint N, typename T, bool Normalized = false>
+struct Attr {
+  static constexpr GLint components = N;
+  static constexpr GLenum type = GLType<T>::value;
+  static constexpr GLboolean normalized = Normalized ? GL_TRUE : GL_FALSE;
+  static constexpr GLsizei size = N * sizeof(T);
+  static constexpr bool unused = false;
+};
+
+// a shader input the layout leaves out; it keeps its location, and the
+// shader reads the default (0, 0, 0, 1)
+struct Unused {
+  static constexpr GLint components = 0;
+  static constexpr GLsizei size = 0;
+  static constexpr bool unused = true;
+};
+
+// what the rest of the engine needs to know about a layout at run time; one
+// instance per layout, so its address identifies the layout
+struct VertexFormat {
+  GLsizei stride;
+  void (*load)();  // point the bound vertex array at the bound buffer
+};
+
+// Interleaved vertex layout, attribute i at location i. Stride and offsets
+// are compile time constants, so a vertex struct can be checked against its
+// layout with static_assert and nothing is computed per mesh.
+template <typename... Attrs>
+struct VertexLayout {
+  static constexpr size_t count = sizeof...(Attrs);
+  static constexpr GLsizei stride = (Attrs::size + ... + 0);
+
+  static constexpr GLsizei offset(size_t index) {
+    constexpr GLsizei sizes[] = {Attrs::size...};
+    GLsizei offset = 0;
+    for (size_t i = 0; i < index; i++) offset += sizes[i];
+    return offset;
+  }
+
+  // whether the layout feeds a vertex shader whose inputs at locations
+  // 0, 1, ... have the given component counts. An attribute may carry more
+  // components than its input reads, e.g. for padding.
+  template <GLint... Inputs>
+  static constexpr bool feeds() {
+    constexpr GLint components[] = {Attrs::components...};
+    constexpr bool unused[] = {Attrs::unused...};
+    constexpr GLint inputs[] = {Inputs...};
+    if (sizeof...(Inputs) != count) return false;
+    for (size_t i = 0; i < count; i++)
+      if (!unused[i] && components[i] < inputs[i]) return false;
+    return true;
+  }
+
+  static void load() {
+    GLuint index = 0;
+    (load_attribute<Attrs>(index++), ...);
+  }
+
+  static inline const VertexFormat format = {stride, &load};
+
+ private:
+  template <typename A>
+  static void load_attribute(GLuint index) {
+    if constexpr (!A::unused) {
+      glVertexAttribPointer(index, A::components, A::type, A::normalized,
+                            stride, (void *)(size_t)offset(index));
+      glEnableVertexAttribArray(index);
+    }
+  }
+};
+
+// compact form of a vertex struct: its Packed type if it declares one, which
+// must be constructible from it, else the struct itself
+template <typename V, typename = void>
+struct PackedVertex {
+  typedef V type;
+};
+template <typename V>
+struct PackedVertex<V, std::void_t<typename V::Packed>> {
+  typedef typename V::Packed type;
+};
@@ -0,0 +1,38 @@
+// Model matrix of a vertex, shared by the vertex shaders through
+// `#include "batch.glsl"`; the including shader declares `uniform mat4 model`.
+// Batched draws fetch their model matrix by draw id.
+layout (location = 7) in int aDrawID;
+
+uniform bool batched;
+uniform bool indirect;
+uniform samplerBuffer models;
+uniform isamplerBuffer draw_vertices;
+uniform int draw_vertices_base;  // texel offset of this batch
+uniform int draw_count;
+// draws sharing a base vertex go out instanced, from draw draw_base on
+uniform bool instanced;
+uniform int draw_base;
+
+int draw_id() {
+    if (indirect) return aDrawID;
+    if (instanced) return draw_base + gl_InstanceID;
+    // draws are sorted by first vertex and gl_VertexID includes the base
+    // vertex, so the last draw starting at or before it is ours
+    int lo = 0;
+    int hi = draw_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (texelFetch(draw_vertices, draw_vertices_base + mid).r <= gl_VertexID)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+mat4 model_matrix() {
+    if (!batched) return model;
+    int i = draw_id() * 4;
+    return mat4(texelFetch(models, i), texelFetch(models, i + 1),
+                texelFetch(models, i + 2), texelFetch(models, i + 3));
+}
@@ -0,0 +1,50 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aColor;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in vec3 aPos2;
+layout (location = 4) in vec2 aSlot;
+
+out vec3 ourColor;
+out vec2 TexCoord;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+uniform float transition;
+
+// the mesh has max_sides corners; corner slot i turns from angles_from[i],
+// where it was on screen, to its corner of a sides_to-gon as sides_blend
+// goes to 1
+uniform int max_sides;
+uniform float angles_from[24];  // MORPH_MAX_SIDES in src/morph.hpp
+uniform int sides_to;
+uniform float sides_blend;
+
+#include "batch.glsl"
+
+// angle of this vertex's corner on a polygon of `sides` corners; the slots
+// of the full mesh are shared out evenly among them
+float corner_angle(int sides) {
+    int corner = int(aSlot.x + 0.5) * sides / max_sides;
+    return 6.28318530718 * float(corner) / float(sides);
+}
+
+void main()
+{
+    float blend = smoothstep(0.0, 1.0, sides_blend);
+    float angle = mix(angles_from[int(aSlot.x + 0.5)], corner_angle(sides_to),
+                      blend);
+    vec3 pos = vec3(length(aPos.xy) * vec2(cos(angle), sin(angle)), aPos.z);
+
+    vec3 target = aSlot.y > 0.5 ? aPos2 : pos;
+    float alpha = smoothstep(0.0, 1.0, transition);
+    gl_Position = projection * view * model_matrix() *
+                  vec4(mix(pos, target, alpha), 1.0);
+
+    ourColor = aColor;
+    ourColor.r = transition;
+    TexCoord = aTexCoord;
+}
@@ -13,9 +13,11 @@ uniform mat4 projection;
 
 uniform float transition;
 
+#include "batch.glsl"
+
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * model_matrix() * vec4(aPos, 1.0);
     ourColor = aColor;
     ourColor.r = transition;
     TexCoord = aTexCoord;
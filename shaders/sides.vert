@@ -15,6 +15,8 @@ uniform mat4 projection;
 // uniform bool pyramid_mode;
 uniform float transition;
 
+#include "batch.glsl"
+
 void main()
 {
 //    if (pyramid_mode) {
@@ -24,7 +26,7 @@ void main()
 //    }
     float alpha = smoothstep(0.0, 1.0, transition);
     vec4 finalPos = vec4(aPos, 1.0) + (vec4(aPos2, 1.0) - vec4(aPos, 1.0)) * alpha;
-    gl_Position = projection * view * model * finalPos;
+    gl_Position = projection * view * model_matrix() * finalPos;
     
     ourColor = aColor;
     ourColor.r = transition;
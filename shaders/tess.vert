@@ -0,0 +1,20 @@
+#version 400 core
+
+layout (location = 0) in vec3 aShape;
+layout (location = 1) in vec2 aPatch;
+
+out vec3 vShape;
+out vec2 vPatch;
+out mat4 vModel;
+
+uniform mat4 model;
+
+#include "batch.glsl"
+
+// the patch is built by the tessellation stages
+void main()
+{
+    vShape = aShape;
+    vPatch = aPatch;
+    vModel = model_matrix();
+}
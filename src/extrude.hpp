@@ -0,0 +1,112 @@
+#pragma once
+
+// standard
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <engine.hpp>
+
+#include "polyhedron.hpp"
+#include "triangulate.hpp"
+
+// Reads an outline file: one "x y" point per line, with blank lines between
+// contours. The first contour is the outline and the rest are holes; lines
+// starting with # are comments.
+Contours read_outline(const std::string &path) {
+  std::ifstream file(path);
+  if (!file) die("Failed to open outline: ", path);
+  Contours contours(1);
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream in(line);
+    float x, y;
+    if (line.size() > 0 && line[0] == '#') continue;
+    if (in >> x >> y) {
+      contours.back().push_back(glm::vec2(x, y));
+    } else if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      if (contours.back().size() > 0) contours.emplace_back();
+    } else {
+      die("Bad line in outline " + path + ": ", line);
+    }
+  }
+  if (contours.back().empty()) contours.pop_back();
+  return contours;
+}
+
+// center the contours on the origin and scale them to fit in a circle of
+// `radius`
+void fit_outline(Contours &contours, float radius) {
+  AABB box;
+  for (auto &contour : contours)
+    for (auto &p : contour) box.add(glm::vec3(p, 0.0f));
+  if (box.empty()) return;
+  glm::vec2 center = glm::vec2((box.min + box.max) * 0.5f);
+  float reach = 0.0f;
+  for (auto &contour : contours)
+    for (auto &p : contour) reach = std::max(reach, glm::length(p - center));
+  float scale = reach > 0.0f ? radius / reach : 1.0f;
+  for (auto &contour : contours)
+    for (auto &p : contour) p = (p - center) * scale;
+}
+
+// Extrude the contours by `length` along z. The caps are triangulated by
+// `triangulator` into `triangles`, working space owned by the caller, and
+// the top and the upper edges of the walls morph to an apex over the origin
+// like the prism top, so the transition uniform turns the extrusion into a
+// pyramid.
+template <typename Vertex>
+void emit_extrusion(Emitter<Vertex> &e, Triangulator &triangulator,
+                    std::vector<unsigned int> &triangles,
+                    const Contours &contours, float length) {
+  TraceScope trace("emit_extrusion", "geometry");
+  triangles.clear();
+  if (!triangulator.triangulate(contours, triangles))
+    die("Outline is not a simple polygon");
+  glm::vec3 apex(0.0f, 0.0f, length);
+  e.begin();
+
+  // base, facing down, then top; the cap vertices come first, in contour
+  // order, so the triangle indices need no remapping
+  GLuint points = 0;
+  glm::vec3 color = randcolor();
+  for (auto &contour : contours)
+    for (auto &p : contour) {
+      glm::vec3 v(p, 0.0f);
+      e.vertex(v, v, color);
+      points++;
+    }
+  color = randcolor();
+  for (auto &contour : contours)
+    for (auto &p : contour) e.vertex(glm::vec3(p, length), apex, color);
+  for (size_t i = 0; i < triangles.size(); i += 3) {
+    GLuint a = triangles[i], b = triangles[i + 1], c = triangles[i + 2];
+    e.triangle(a, c, b);
+    e.triangle(points + a, points + b, points + c);
+  }
+
+  // walls, one quad per edge, facing out
+  for (size_t c = 0; c < contours.size(); c++) {
+    const std::vector<glm::vec2> &contour = contours[c];
+    int n = contour.size();
+    // triangles come out counter-clockwise, so the outline must run that
+    // way and holes the other way for the walls to face out
+    double area = 0;
+    for (int i = 0; i < n; i++)
+      area += double(contour[i].x) * contour[(i + 1) % n].y -
+              double(contour[(i + 1) % n].x) * contour[i].y;
+    bool flip = (area > 0) != (c == 0);
+    for (int i = 0; i < n; i++) {
+      glm::vec2 a = contour[i], b = contour[(i + 1) % n];
+      if (flip) std::swap(a, b);
+      color = randcolor();
+      glm::vec3 a0(a, 0.0f), b0(b, 0.0f);
+      GLuint v0 = e.vertex(a0, a0, color), v1 = e.vertex(b0, b0, color);
+      GLuint v2 = e.vertex(glm::vec3(b, length), apex, color);
+      GLuint v3 = e.vertex(glm::vec3(a, length), apex, color);
+      e.triangle(v0, v1, v2);
+      e.triangle(v0, v2, v3);
+    }
+  }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+// standard
+#include <iostream>
+#include <vector>
+
+#include <engine.hpp>
+
+#include "lod.hpp"
+
+// a floor of FIELD_SIZE x FIELD_SIZE prisms standing upright below and
+// behind the main shape, each at FIELD_SIDES sides when close up
+const int FIELD_SIZE = 50;
+const int FIELD_SIDES = 512;
+const float FIELD_SPACING = 0.5f;
+const float FIELD_LENGTH = 0.2f;
+
+struct Field {
+  std::vector<Mesh *> meshes;
+  std::vector<PrismLod> lods;
+  bool visible = false;
+  bool gpu = false;  // culled and drawn by game.gpu_culler instead
+};
+
+void build_field(Game &game, Field &field, LodCache &cache) {
+  TraceScope trace("build_field", "geometry");
+  PrismLod lod = prism_lod(cache, FIELD_SIDES, FIELD_LENGTH);
+  cache.upload();
+  ArenaRange coarsest = cache.range(lod.entries[lod.count - 1]);
+  lod.level = lod.count - 1;
+  glm::quat upright = glm::angleAxis(glm::radians(-90.0f), BasisVectors::X);
+  for (int i = 0; i < FIELD_SIZE; i++)
+    for (int j = 0; j < FIELD_SIZE; j++) {
+      Mesh *mesh = game.add_shape(Mesh(coarsest, GL_TRIANGLES,
+                                       "shaders/sides.vert",
+                                       "shaders/sides.frag",
+                                       "textures/cement_wall.jpeg"));
+      transforms.set_position(
+          mesh->transform, glm::vec3((i - FIELD_SIZE / 2) * FIELD_SPACING,
+                                     -1.0f, 1.0f - j * FIELD_SPACING));
+      transforms.set_rotation(mesh->transform, upright);
+      mesh->set_visible(field.visible);
+      field.meshes.push_back(mesh);
+      field.lods.push_back(lod);
+    }
+}
+
+void show_field(Game &game, Field &field, bool visible) {
+  field.visible = visible;
+  for (auto &mesh : field.meshes) mesh->set_visible(visible && !field.gpu);
+  game.gpu_culler.enabled = visible && field.gpu;
+}
+
+// Hand the field to the compute culler, or take it back. Every prism shares
+// the levels of the first one, whose mesh the culler draws with.
+void gpu_field(Game &game, Field &field, LodCache &cache, bool gpu) {
+  if (gpu && !game.gpu_culler.available) {
+    std::cout << "GPU culling needs OpenGL 4.3" << std::endl;
+    return;
+  }
+  field.gpu = gpu;
+  if (gpu) {
+    cache.upload();
+    const PrismLod &first = field.lods[0];
+    std::vector<GpuLod> lods;
+    for (int l = 0; l < first.count; l++) {
+      ArenaRange range = cache.range(first.entries[l]);
+      lods.push_back({range.index_count, range.first_index,
+                      range.base_vertex, GLfloat(first.sides[l])});
+    }
+    field.meshes[0]->show(cache.range(first.entries[first.count - 1]),
+                          cache.bounds(first.entries[first.count - 1]));
+
+    std::vector<GpuInstance> instances;
+    std::vector<TransformHandle> handles;
+    for (size_t i = 0; i < field.meshes.size(); i++) {
+      const PrismLod &lod = field.lods[i];
+      instances.push_back({glm::vec4(lod.center, lod.radius), 0, lod.count,
+                           lod.level, 0});
+      handles.push_back(field.meshes[i]->transform);
+    }
+    game.gpu_culler.set(field.meshes[0], lods, instances, handles);
+  }
+  show_field(game, field, field.visible);
+}
+
+// pick the level of every prism for this frame, unless the compute culler
+// picks them; it takes the moved prisms from the transform store itself
+void select_field_lods(Game &game, Field &field, LodSelector &selector,
+                       LodCache &cache) {
+  if (!field.visible || field.gpu) return;
+  TraceScope trace("select_field_lods", "update");
+  cache.upload();
+  selector.begin(game.camera, game.height);
+  for (size_t i = 0; i < field.meshes.size(); i++)
+    selector.select(*field.meshes[i], field.lods[i], cache);
+  selector.end();
+}
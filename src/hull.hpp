@@ -0,0 +1,357 @@
+#pragma once
+
+// standard
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <engine.hpp>
+#include <pool.hpp>
+
+#include "polyhedron.hpp"
+
+// Convex hull of a set of points by QuickHull: start from a tetrahedron of
+// extreme points, then repeatedly add the point furthest in front of a face,
+// replacing the faces it sees by a cone from the horizon to the point.
+class QuickHull {
+ public:
+  // append the hull of points[ids[i]] to `triangles`, counter-clockwise seen
+  // from outside, as point indices. Returns false when the points are flat.
+  bool build(const glm::vec3 *points, const std::vector<int> &ids,
+             std::vector<int> &triangles) {
+    this->ids = &ids;
+    int n = ids.size();
+    if (n < 4) return false;
+    p.resize(n);
+    double scale = 0;
+    for (int i = 0; i < n; i++) {
+      p[i] = glm::dvec3(points[ids[i]]);
+      scale = std::max(scale, std::max(std::abs(p[i].x),
+                                       std::max(std::abs(p[i].y),
+                                                std::abs(p[i].z))));
+    }
+    epsilon = 1e-11 * std::max(scale, 1e-30);
+    faces.clear();
+    if (!simplex()) return false;
+    start_of.assign(n, -1);
+    for (size_t f = 0; f < faces.size(); f++)
+      while (faces[f].alive && faces[f].outside.size() > 0) add(f);
+
+    for (auto &f : faces)
+      if (f.alive)
+        for (int i = 0; i < 3; i++) triangles.push_back(ids[f.v[i]]);
+    return true;
+  }
+
+ private:
+  struct Face {
+    int v[3];
+    // face across the edge from v[i] to v[i + 1]
+    int neighbor[3] = {-1, -1, -1};
+    glm::dvec3 normal;
+    double offset;
+    std::vector<int> outside;  // points in front of the face
+    int furthest = -1;
+    double furthest_distance = 0;
+    bool alive = true;
+    int mark = 0;  // visit of the last search that reached the face
+    bool visible = false;
+  };
+
+  const std::vector<int> *ids = NULL;
+  std::vector<glm::dvec3> p;
+  std::vector<Face> faces;
+  double epsilon = 0;
+  int visit = 0;
+
+  // horizon of the current point: the visible side of each edge
+  struct Edge {
+    int face, edge;
+  };
+  std::vector<int> stack, visible, start_of, orphans;
+  std::vector<Edge> horizon;
+
+  double distance(const Face &f, int i) const {
+    return glm::dot(f.normal, p[i]) - f.offset;
+  }
+
+  int make_face(int a, int b, int c) {
+    Face f;
+    f.v[0] = a, f.v[1] = b, f.v[2] = c;
+    glm::dvec3 n = glm::cross(p[b] - p[a], p[c] - p[a]);
+    double length = glm::length(n);
+    f.normal = length > 0 ? n / length : n;
+    f.offset = glm::dot(f.normal, p[a]);
+    faces.push_back(std::move(f));
+    return faces.size() - 1;
+  }
+
+  // file point i with the face it is furthest in front of, if any
+  void assign(int i, int first_face, int last_face) {
+    int best = -1;
+    double best_distance = epsilon;
+    for (int f = first_face; f < last_face; f++) {
+      double d = distance(faces[f], i);
+      if (d > best_distance) best = f, best_distance = d;
+    }
+    if (best < 0) return;
+    Face &f = faces[best];
+    f.outside.push_back(i);
+    if (best_distance > f.furthest_distance)
+      f.furthest = i, f.furthest_distance = best_distance;
+  }
+
+  // link two faces of the starting tetrahedron across their shared edge
+  void link(int f, int g) {
+    for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++)
+        if (faces[f].v[i] == faces[g].v[(j + 1) % 3] &&
+            faces[f].v[(i + 1) % 3] == faces[g].v[j]) {
+          faces[f].neighbor[i] = g;
+          faces[g].neighbor[j] = f;
+        }
+  }
+
+  bool simplex() {
+    int n = p.size();
+    // the two furthest apart of the extreme points along the axes
+    int extreme[6] = {0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < n; i++)
+      for (int axis = 0; axis < 3; axis++) {
+        if (p[i][axis] < p[extreme[axis * 2]][axis]) extreme[axis * 2] = i;
+        if (p[i][axis] > p[extreme[axis * 2 + 1]][axis])
+          extreme[axis * 2 + 1] = i;
+      }
+    int a = 0, b = 0;
+    double widest = -1;
+    for (int axis = 0; axis < 3; axis++) {
+      int lo = extreme[axis * 2], hi = extreme[axis * 2 + 1];
+      double d = glm::length(p[hi] - p[lo]);
+      if (d > widest) widest = d, a = lo, b = hi;
+    }
+    if (widest <= epsilon) return false;
+
+    // the point furthest from line ab, then from plane abc
+    int c = -1, d = -1;
+    double best = epsilon;
+    glm::dvec3 direction = (p[b] - p[a]) / widest;
+    for (int i = 0; i < n; i++) {
+      double from_line = glm::length(glm::cross(p[i] - p[a], direction));
+      if (from_line > best) best = from_line, c = i;
+    }
+    if (c < 0) return false;
+    glm::dvec3 normal = glm::cross(p[b] - p[a], p[c] - p[a]);
+    normal = normal / glm::length(normal);
+    best = epsilon;
+    for (int i = 0; i < n; i++) {
+      double from_plane = std::abs(glm::dot(normal, p[i] - p[a]));
+      if (from_plane > best) best = from_plane, d = i;
+    }
+    if (d < 0) return false;
+
+    // keep every face facing away from the fourth corner
+    if (glm::dot(normal, p[d] - p[a]) > 0) std::swap(b, c);
+    int f[4] = {make_face(a, b, c), make_face(a, d, b), make_face(b, d, c),
+                make_face(c, d, a)};
+    for (int i = 0; i < 4; i++)
+      for (int j = i + 1; j < 4; j++) link(f[i], f[j]);
+    for (int i = 0; i < n; i++)
+      if (i != a && i != b && i != c && i != d) assign(i, 0, 4);
+    return true;
+  }
+
+  // add the furthest outside point of face f to the hull
+  void add(int f) {
+    int eye = faces[f].furthest;
+    visit++;
+    visible.clear();
+    horizon.clear();
+    stack.assign(1, f);
+    faces[f].mark = visit;
+    faces[f].visible = true;
+    while (stack.size() > 0) {
+      int g = stack.back();
+      stack.pop_back();
+      visible.push_back(g);
+      for (int i = 0; i < 3; i++) {
+        int h = faces[g].neighbor[i];
+        if (faces[h].mark != visit) {
+          faces[h].mark = visit;
+          faces[h].visible = distance(faces[h], eye) > epsilon;
+          if (faces[h].visible) stack.push_back(h);
+        }
+        if (!faces[h].visible) horizon.push_back({g, i});
+      }
+    }
+
+    // rounding can make the visible region something other than a disc;
+    // then the point is dropped, as it lies within epsilon of the hull
+    bool closed = true;
+    for (auto &e : horizon) {
+      int a = faces[e.face].v[e.edge];
+      if (start_of[a] >= 0) closed = false;
+      start_of[a] = 0;
+    }
+    for (auto &e : horizon) {
+      int b = faces[e.face].v[(e.edge + 1) % 3];
+      if (start_of[b] < 0) closed = false;
+    }
+    if (!closed) {
+      for (auto &e : horizon) start_of[faces[e.face].v[e.edge]] = -1;
+      drop(f, eye);
+      return;
+    }
+
+    // a cone of new faces from the horizon to the eye point
+    int first_new = faces.size();
+    for (auto &e : horizon) {
+      int a = faces[e.face].v[e.edge], b = faces[e.face].v[(e.edge + 1) % 3];
+      int outer = faces[e.face].neighbor[e.edge];
+      int g = make_face(a, b, eye);
+      faces[g].neighbor[0] = outer;
+      Face &o = faces[outer];
+      for (int i = 0; i < 3; i++)
+        if (o.v[i] == b && o.v[(i + 1) % 3] == a) o.neighbor[i] = g;
+      start_of[a] = g;
+    }
+    for (int g = first_new; g < int(faces.size()); g++) {
+      int next = start_of[faces[g].v[1]];
+      faces[g].neighbor[1] = next;
+      faces[next].neighbor[2] = g;
+    }
+    for (int g = first_new; g < int(faces.size()); g++)
+      start_of[faces[g].v[0]] = -1;
+
+    // points that saw the old faces go to the new ones or are inside now
+    orphans.clear();
+    for (int g : visible) {
+      Face &old = faces[g];
+      old.alive = false;
+      for (int i : old.outside)
+        if (i != eye) orphans.push_back(i);
+      std::vector<int>().swap(old.outside);
+    }
+    for (int i : orphans) assign(i, first_new, faces.size());
+  }
+
+  // forget point `eye` in front of face f
+  void drop(int f, int eye) {
+    Face &face = faces[f];
+    face.outside.erase(
+        std::find(face.outside.begin(), face.outside.end(), eye));
+    face.furthest = -1;
+    face.furthest_distance = 0;
+    for (int i : face.outside) {
+      double d = distance(face, i);
+      if (d > face.furthest_distance)
+        face.furthest = i, face.furthest_distance = d;
+    }
+    if (face.furthest < 0) face.outside.clear();
+  }
+};
+
+// the corners of the hull of points[ids[i]], sorted; all the ids if they
+// are flat
+void hull_corners(const std::vector<glm::vec3> &points, std::vector<int> &ids,
+                  std::vector<int> &out) {
+  std::vector<int> triangles;
+  QuickHull hull;
+  if (!hull.build(points.data(), ids, triangles))
+    out.swap(ids);
+  else
+    out.swap(triangles);
+  std::sort(out.begin(), out.end());
+  out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+// Hull of a whole cloud on a thread pool: the cloud is split in chunks,
+// each chunk is hulled on its own, and the chunk hulls are merged pairwise,
+// a round at a time on the pool, since the hull of the corners of two hulls
+// is the hull of both. Only the last merge is serial. It is small when few
+// points are corners, as in a filled ball; when most points are corners,
+// as on a sphere, it hulls nearly the whole cloud and bounds the speedup.
+bool convex_hull(const std::vector<glm::vec3> &points,
+                 std::vector<int> &triangles, ThreadPool &pool = thread_pool) {
+  TraceScope trace("convex_hull", "geometry");
+  const size_t min_chunk = 1 << 14;
+  size_t chunks =
+      std::min<size_t>(pool.size() * 2, points.size() / min_chunk);
+  std::vector<int> candidates;
+  if (chunks < 2) {
+    candidates.resize(points.size());
+    for (size_t i = 0; i < points.size(); i++) candidates[i] = i;
+  } else {
+    std::vector<std::vector<int>> corners(chunks);
+    pool.parallel_chunks(
+        points.size(), chunks, [&](size_t chunk, size_t begin, size_t end) {
+          TraceScope trace("chunk hull", "geometry");
+          std::vector<int> ids(end - begin);
+          for (size_t i = begin; i < end; i++) ids[i - begin] = i;
+          hull_corners(points, ids, corners[chunk]);
+        });
+    while (corners.size() > 2) {
+      size_t pairs = corners.size() / 2;
+      pool.parallel_for(pairs, 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+          TraceScope trace("merge hulls", "geometry");
+          std::vector<int> ids(corners[2 * i]);
+          ids.insert(ids.end(), corners[2 * i + 1].begin(),
+                     corners[2 * i + 1].end());
+          hull_corners(points, ids, corners[2 * i]);
+        }
+      });
+      // pair i lands in slot i; an odd set out moves up as it is
+      for (size_t i = 0; i < pairs; i++) corners[i].swap(corners[2 * i]);
+      if (corners.size() % 2) corners[pairs].swap(corners.back());
+      corners.resize(pairs + corners.size() % 2);
+    }
+    for (auto &v : corners)
+      candidates.insert(candidates.end(), v.begin(), v.end());
+  }
+  QuickHull hull;
+  return hull.build(points.data(), candidates, triangles);
+}
+
+// mean of the points, summed per chunk on the thread pool
+glm::vec3 centroid(const std::vector<glm::vec3> &points) {
+  size_t chunks = std::max<size_t>(1, std::min<size_t>(thread_pool.size(),
+                                                       points.size() >> 16));
+  std::vector<glm::dvec3> sums(chunks, glm::dvec3(0.0));
+  thread_pool.parallel_chunks(points.size(), chunks,
+                              [&](size_t chunk, size_t begin, size_t end) {
+                                glm::dvec3 sum(0.0);
+                                for (size_t i = begin; i < end; i++)
+                                  sum += glm::dvec3(points[i]);
+                                sums[chunk] = sum;
+                              });
+  glm::dvec3 sum(0.0);
+  for (auto &s : sums) sum += s;
+  return glm::vec3(sum / double(std::max<size_t>(points.size(), 1)));
+}
+
+// Flat shaded faces of a hull, each collapsing to `center` as the transition
+// goes to 1.
+template <typename Vertex>
+void emit_hull(Emitter<Vertex> &e, const std::vector<glm::vec3> &points,
+               const std::vector<int> &triangles, glm::vec3 center) {
+  e.begin();
+  glm::vec3 m[] = {center, center, center};
+  for (size_t i = 0; i < triangles.size(); i += 3) {
+    glm::vec3 t[] = {points[triangles[i]], points[triangles[i + 1]],
+                     points[triangles[i + 2]]};
+    e.triangle(t, m, randcolor());
+  }
+}
+
+// Reads a point cloud file with one "x y z" point per line.
+std::vector<glm::vec3> read_points(const std::string &path) {
+  std::ifstream file(path);
+  if (!file) die("Failed to open point cloud: ", path);
+  std::vector<glm::vec3> points;
+  float x, y, z;
+  while (file >> x >> y >> z) points.push_back(glm::vec3(x, y, z));
+  if (!file.eof()) die("Bad point in point cloud: ", path);
+  return points;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+// standard
+#include <cmath>
+#include <map>
+#include <utility>
+
+#include <engine.hpp>
+
+#include "polyhedron.hpp"
+
+// levels of detail halve the side count down to LOD_MIN_SIDES
+const int LOD_MAX_LEVELS = 16;
+const int LOD_MIN_SIDES = 6;
+
+// a prism moves to a coarser level only when that level has this much more
+// sides than it needs, so prisms near a threshold do not pop
+const float LOD_HYSTERESIS = 0.25f;
+
+// Prism geometry by side count, emitted once and shared by every level of
+// every prism that asks for the same count. New entries reach the GPU on
+// upload(), which moves the earlier ones too, so meshes must take their
+// ranges again afterwards; LodSelector does every frame.
+class LodCache {
+ public:
+  int entry(int sides, float length) {
+    auto key = std::make_pair(sides, length);
+    auto it = entries.find(key);
+    if (it != entries.end()) return it->second;
+    PolyhedronSpec s = family_spec(PRISM, sides, length);
+    int e = catalog.add(morph_pair(s, apex_of(s)));
+    entries[key] = e;
+    dirty = true;
+    return e;
+  }
+
+  void upload() {
+    if (!dirty) return;
+    catalog.upload();
+    dirty = false;
+  }
+
+  ArenaRange range(int entry) const { return catalog.range(entry); }
+  const AABB &bounds(int entry) const { return catalog.bounds(entry); }
+
+ private:
+  PolyhedronCatalog<SidesVertex> catalog;
+  std::map<std::pair<int, float>, int> entries;
+  bool dirty = false;
+};
+
+// the levels of one prism, finest first, and the one it shows
+struct PrismLod {
+  int sides[LOD_MAX_LEVELS];
+  int entries[LOD_MAX_LEVELS];
+  int count = 0;
+  int level = 0;
+  // bounding sphere in model space
+  glm::vec3 center;
+  float radius;
+};
+
+PrismLod prism_lod(LodCache &cache, int sides, float length) {
+  PrismLod lod;
+  for (int n = sides; lod.count < LOD_MAX_LEVELS; n /= 2) {
+    lod.sides[lod.count] = n;
+    lod.entries[lod.count] = cache.entry(n, length);
+    lod.count++;
+    if (n / 2 < LOD_MIN_SIDES) break;
+  }
+  // the ring radius of family_spec
+  float ring = length / 1.5f;
+  lod.center = glm::vec3(0.0f, 0.0f, length / 2);
+  lod.radius = std::sqrt(ring * ring + length * length / 4);
+  return lod;
+}
+
+// Picks the level of each prism from the screen size of its bounding
+// sphere: the coarsest level whose sides stray at most pixel_error pixels
+// from the circle, as in shaders/tess.tesc. When a frame goes over the
+// triangle budget the allowed error grows for the next one, and it shrinks
+// back once the frame fits in half the budget.
+class LodSelector {
+ public:
+  float min_pixel_error = 0.5f;
+  float pixel_error = 0.5f;
+  size_t triangle_budget = 2000000;
+  size_t triangles = 0;  // in the visible levels picked since begin()
+
+  void begin(Camera &camera, float viewport_height) {
+    view = camera.GetViewMatrix();
+    frustum = frustum_planes(camera.GetProjectionMatrix() * view);
+    scale = camera.GetProjectionMatrix()[1][1] * 0.5f * viewport_height;
+    triangles = 0;
+  }
+
+  // prisms outside the view, behind the camera included, take their
+  // coarsest level and do not count against the budget
+  void select(Mesh &mesh, PrismLod &lod, const LodCache &cache) {
+    glm::vec4 world = mesh.model() * glm::vec4(lod.center, 1.0f);
+    bool seen = sphere_in_frustum(frustum, {glm::vec3(world), lod.radius});
+
+    int level = lod.count - 1;
+    if (seen) {
+      float depth = -(view * world).z;
+      float needed = lod.sides[0];
+      if (depth > lod.radius) {
+        float pixels = lod.radius * scale / depth;
+        needed = 3.14159265f * std::sqrt(pixels / (2.0f * pixel_error));
+      }
+
+      level = lod.level;
+      if (lod.sides[level] < needed) {
+        // finer, just enough
+        while (level > 0 && lod.sides[level] < needed) level--;
+      } else {
+        // coarser, with room to spare
+        float spare = needed * (1.0f + LOD_HYSTERESIS);
+        while (level + 1 < lod.count && lod.sides[level + 1] >= spare)
+          level++;
+      }
+    }
+    lod.level = level;
+
+    int e = lod.entries[level];
+    ArenaRange range = cache.range(e);
+    mesh.show(range, cache.bounds(e));
+    if (seen) triangles += range.index_count / 3;
+  }
+
+  void end() {
+    if (triangles > triangle_budget)
+      pixel_error *= 1.25f;
+    else if (triangles < triangle_budget / 2)
+      pixel_error = std::max(min_pixel_error, pixel_error / 1.25f);
+  }
+
+ private:
+  glm::mat4 view;
+  Frustum frustum;
+  float scale = 1.0f;
+};
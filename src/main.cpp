@@ -1,12 +1,43 @@
 #include "engine.hpp"
+#include "extrude.hpp"
+#include "field.hpp"
+#include "hull.hpp"
+#include "morph.hpp"
+#include "polyhedron.hpp"
 #include "prism.hpp"
+#include "tess.hpp"
 
 Game game("Assignment 0", 800, 600);
+// after the game, so the tables are released before it tears down the arena
+PrismTables prism_tables;
+PolyhedronCatalog<SidesVertex> family_catalog;
+LodCache lod_cache;
+// thousands of prisms at screen-size levels of detail, toggled with R
+Field field;
+LodSelector lod_selector;
 int sides = 3;
+Family family = PRISM;
+// base, sides and top of the prism, then one mesh for the other families
 std::vector<Mesh *> prism;
+// where side counts outside the tables are emitted
+PrismGeometry prism_geometry;
+PolyhedronBuffers<SidesVertex> family_buffers;
+// prisms above TESS_MIN_SIDES sides, drawn by the tessellation shaders
+Mesh *tess_prism = NULL;
+TessBuffers tess_buffers;
+// an outline from the command line, extruded in place of the prism
+Mesh *extrusion = NULL;
+// convex hull of a point cloud, toggled with G
+Mesh *hull = NULL;
+bool show_hull = false;
+// the prism at MORPH_MAX_SIDES, which animates side changes in morph mode
+std::vector<Mesh *> morph_prism;
+bool morph_mode = false;
+SideMorph side_morph;
 float transition = 0.0f;
 int transition_direction = 0;  // +1 for prism, -1 for pyramid
 bool help = false;
+bool show_profiler = false;
 int name_x = 0;
 
 void update(Game &game) {
@@ -25,7 +56,24 @@ void update(Game &game) {
       s->shader->use();
       s->shader->setFloat("transition", transition);
     }
+    for (auto &s : morph_prism) {
+      s->shader->use();
+      s->shader->setFloat("transition", transition);
+    }
+    if (tess_prism) {
+      tess_prism->shader->use();
+      tess_prism->shader->setFloat("transition", transition);
+    }
+  }
+  if (tess_prism && tess_prism->visible()) {
+    tess_prism->shader->use();
+    tess_prism->shader->setFloat("viewport_height", game.height);
   }
+  if (side_morph.animating()) {
+    side_morph.update();
+    side_morph.apply(morph_prism[0]->shader);
+  }
+  select_field_lods(game, field, lod_selector, lod_cache);
   // game.camera.Front = cameraFront;
   // game.camera.Zoom = mouse_fov;
 }
@@ -55,10 +103,13 @@ std::string prefix(int sides) {
 
 void render(Game &game) {
   std::string polyhedron = transition < 0.5 ? "prism" : "pyramid";
+  if (family != PRISM) polyhedron = family_name(family);
   std::string name = prefix(sides) + " " + polyhedron;
 
   if (name == "triangular pyramid") name = "tetrahedron";
   if (name == "square prism") name = "cube";
+  if (extrusion) name = transition < 0.5 ? "extrusion" : "outline pyramid";
+  if (show_hull) name = transition < 0.5 ? "convex hull" : "collapsed hull";
   game.text(name, name_x, 15.0, 0.8);
 
   if (help) {
@@ -69,7 +120,15 @@ void render(Game &game) {
             "WASDQE = Move Camera",
             "+- = Change sides",
             "T = Toggle Prism / Pyramid",
+            "F = Cycle Polyhedron Family",
+            "G = Toggle Convex Hull of a Point Cloud",
+            "TAB = Toggle Animated Side Changes",
+            "R = Toggle Field of Prisms",
+            "Y = Toggle GPU Culling of the Field",
             "VBNM = Auto Rotation",
+            "P = Toggle Profiler",
+            "F9 = Start / Stop Trace",
+            "F10 = Start / Stop Stats Log",
             "ZXC = Manual Rotation",
             "ESC = Exit",
         },
@@ -77,19 +136,131 @@ void render(Game &game) {
   } else {
     game.text("H = Help", 0, game.height - 50, 0.8);
   }
+
+  if (show_profiler) {
+    auto lines = game.profiler.report();
+    auto counters = game.stats.last.report();
+    lines.insert(lines.end(), counters.begin(), counters.end());
+    if (field.visible && !field.gpu)
+      lines.push_back("field triangles " +
+                      std::to_string(lod_selector.triangles));
+    game.text(lines, game.width - 260, game.height - 30, 0.4);
+  }
+}
+
+// whether the prism is drawn by the tessellation shaders
+bool tessellated() {
+  return family == PRISM && sides > TESS_MIN_SIDES && tessellation_available();
+}
+
+// show either the classic or tessellated prism meshes, the family mesh, the
+// morph prism, the extrusion or the hull
+void show_family_meshes() {
+  bool classic = !extrusion && !show_hull && !morph_mode;
+  for (int i = 0; i < 3; i++)
+    prism[i]->set_visible(classic && family == PRISM && !tessellated());
+  if (tess_prism) tess_prism->set_visible(classic && tessellated());
+  prism[3]->set_visible(classic && family != PRISM);
+  for (auto &s : morph_prism) s->set_visible(morph_mode && !show_hull);
+  if (extrusion) extrusion->set_visible(!show_hull && !morph_mode);
+  if (hull) hull->set_visible(show_hull);
+}
+
+void extrude_outline(const std::string &path) {
+  TraceScope trace("extrude_outline", "geometry");
+  Contours contours = read_outline(path);
+  fit_outline(contours, 0.7 / 1.5);
+  std::vector<SidesVertex> vertices;
+  std::vector<GLuint> indices;
+  Emitter<SidesVertex> emitter(vertices, indices);
+  Triangulator triangulator;
+  std::vector<unsigned int> triangles;
+  emit_extrusion(emitter, triangulator, triangles, contours, 0.7);
+  extrusion = game.add_shape(Mesh(vertices, indices, GL_TRIANGLES,
+                                  "shaders/sides.vert", "shaders/sides.frag",
+                                  "textures/cement_wall.jpeg"));
+}
+
+// hull of `points`, scaled to the prism size around their centroid. Only the
+// hull corners are moved; the rest of the cloud is left as it was.
+void build_hull(std::vector<glm::vec3> &points) {
+  TraceScope trace("build_hull", "geometry");
+  std::vector<int> triangles;
+  if (!convex_hull(points, triangles)) die("Point cloud is flat");
+  glm::vec3 center = centroid(points);
+  std::vector<int> corners(triangles);
+  std::sort(corners.begin(), corners.end());
+  corners.erase(std::unique(corners.begin(), corners.end()), corners.end());
+  float reach = 0.0f;
+  for (int i : corners)
+    reach = std::max(reach, glm::length(points[i] - center));
+  float scale = reach > 0.0f ? 0.7f / 1.5f / reach : 1.0f;
+  for (int i : corners) points[i] = (points[i] - center) * scale;
+
+  std::vector<SidesVertex> vertices;
+  std::vector<GLuint> indices;
+  Emitter<SidesVertex> emitter(vertices, indices);
+  emit_hull(emitter, points, triangles, glm::vec3(0.0f));
+  hull = game.add_shape(Mesh(vertices, indices, GL_TRIANGLES,
+                             "shaders/sides.vert", "shaders/sides.frag",
+                             "textures/cement_wall.jpeg"));
+}
+
+// a million points filling a ball with its top and bottom cut off
+std::vector<glm::vec3> random_cloud() {
+  std::vector<glm::vec3> points;
+  points.reserve(1000000);
+  while (points.size() < 1000000) {
+    glm::vec3 p(randfloat(-1, 1), randfloat(-1, 1), randfloat(-0.5, 0.5));
+    if (glm::dot(p, p) <= 1.0f) points.push_back(p);
+  }
+  return points;
 }
 
 void create_shapes() {
-  if (game.shapes.size() > 0) {
-    // save state
-    auto state = game.shapes.front()->state;
-    game.delete_shapes();
-    game.add_shapes(prism = generate_prism(sides, 0.7));
-    // restore state
-    for (auto &s : prism) s->state = state;
+  TraceScope trace("create_shapes", "geometry");
+  // existing meshes are rebuilt in place and keep their state
+  if (tessellated()) {
+    if (tess_prism)
+      update_tess_prism(*tess_prism, tess_buffers, sides, 0.7);
+    else {
+      tess_prism = game.add_shape(generate_tess_prism(sides, 0.7));
+      tess_prism->shader->use();
+      tess_prism->shader->setFloat("transition", transition);
+    }
+  }
+  if (prism.size() > 0) {
+    if (!tessellated())
+      update_prism(prism_tables, prism_geometry, prism, sides, 0.7);
+  } else {
+    // the classic meshes start small when the prism is tessellated
+    prism = game.add_shapes(
+        generate_prism(prism_tables, tessellated() ? 3 : sides, 0.7));
+    prism.push_back(game.add_shape(
+        Mesh(family_catalog.range(0), GL_TRIANGLES, "shaders/sides.vert",
+             "shaders/sides.frag", "textures/cement_wall.jpeg")));
+  }
+  if (family != PRISM)
+    show_family(*prism[3], family_catalog, family_buffers, family, sides,
+                0.7);
+  show_family_meshes();
+}
+
+// switch between regenerating meshes on side changes and morphing the
+// MORPH_MAX_SIDES prism in the vertex shader
+void toggle_morph_mode() {
+  morph_mode = !morph_mode;
+  if (morph_mode) {
+    if (morph_prism.empty())
+      morph_prism = game.add_shapes(generate_morph_prism(0.7));
+    sides = std::min(sides, MORPH_MAX_SIDES);
+    side_morph.jump(sides);
+    side_morph.apply(morph_prism[0]->shader);
+    morph_prism[0]->shader->setFloat("transition", transition);
   } else {
-    game.add_shapes(prism = generate_prism(sides, 0.7));
+    create_shapes();
   }
+  show_family_meshes();
 }
 
 void processInput(Game &game) {
@@ -102,31 +273,95 @@ void processInput(Game &game) {
         transition_direction = -1;
   }
 
+  if (game.on_keyup(GLFW_KEY_G)) {
+    if (!hull) {
+      std::vector<glm::vec3> cloud = random_cloud();
+      build_hull(cloud);
+    }
+    show_hull = !show_hull;
+    show_family_meshes();
+  }
+  if (game.on_keyup(GLFW_KEY_TAB)) toggle_morph_mode();
+  if (game.on_keyup(GLFW_KEY_R)) {
+    if (field.meshes.empty()) build_field(game, field, lod_cache);
+    show_field(game, field, !field.visible);
+  }
+  if (game.on_keyup(GLFW_KEY_Y)) {
+    if (field.meshes.empty()) build_field(game, field, lod_cache);
+    gpu_field(game, field, lod_cache, !field.gpu);
+  }
+  if (game.on_keyup(GLFW_KEY_F)) {
+    family = Family((family + 1) % FAMILY_COUNT);
+    create_shapes();
+  }
+
   if (game.on_keyup(GLFW_KEY_H)) help = !help;
+  if (game.on_keyup(GLFW_KEY_P)) show_profiler = !show_profiler;
+  if (game.on_keyup(GLFW_KEY_F9)) {
+    if (tracer.recording())
+      tracer.stop();
+    else
+      tracer.start("trace.json");
+  }
+  if (game.on_keyup(GLFW_KEY_F10)) {
+    if (game.stats.logging())
+      game.stats.stop_log();
+    else
+      game.stats.start_log("stats.csv");
+  }
   if (game.on_keyup(GLFW_KEY_SPACE)) {
     // reset state
-    for (auto &s : prism) s->state.reset();
+    for (auto &s : prism) transforms.reset(s->transform);
+    for (auto &s : morph_prism) transforms.reset(s->transform);
+    if (tess_prism) transforms.reset(tess_prism->transform);
+    if (extrusion) transforms.reset(extrusion->transform);
+    if (hull) transforms.reset(hull->transform);
+    show_family_meshes();
     game.camera.Position = glm::vec3(0.0f, 0.0f, 3.0f);
   }
 
-  if (game.on_keyup(GLFW_KEY_KP_ADD)) {
+  // holding +- sweeps through the side counts; in morph mode the change
+  // animates without touching the meshes
+  if (game.on_keyrepeat(GLFW_KEY_KP_ADD) &&
+      (!morph_mode || sides < MORPH_MAX_SIDES)) {
     sides++;
-    create_shapes();
+    if (morph_mode)
+      side_morph.retarget(sides);
+    else
+      create_shapes();
   }
-  if (game.on_keyup(GLFW_KEY_KP_SUBTRACT) && sides > 3) {
+  if (game.on_keyrepeat(GLFW_KEY_KP_SUBTRACT) && sides > 3) {
     sides--;
-    create_shapes();
+    if (morph_mode)
+      side_morph.retarget(sides);
+    else
+      create_shapes();
   }
 }
 
 int main(int argc, char *argv[]) {
-  // parse number of sides of the polygon in the prism
+  // parse number of sides of the polygon in the prism, and an optional
+  // outline file to extrude or point cloud to hull instead
   if (argc > 1) sides = std::stoi(argv[1]);
 
   // Shader *shader = new Shader("shaders/shader.frag", "shaders/shader.vert");
   // Texture *texture = new Texture("textures/cement_wall.jpeg");
 
+  prism_tables.upload(0.7);
+  build_family_catalog(family_catalog, 0.7);
   create_shapes();
+  if (argc > 2) {
+    // .xyz point clouds are hulled, anything else is an outline
+    std::string path = argv[2];
+    if (path.size() > 4 && path.substr(path.size() - 4) == ".xyz") {
+      std::vector<glm::vec3> cloud = read_points(path);
+      build_hull(cloud);
+      show_hull = true;
+    } else {
+      extrude_outline(path);
+    }
+    show_family_meshes();
+  }
 
   game.loop(processInput, update, render);
 }
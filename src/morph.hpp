@@ -0,0 +1,101 @@
+#pragma once
+
+#include <engine.hpp>
+
+#include "ring.hpp"
+
+// largest side count the morphing prism can show
+const int MORPH_MAX_SIDES = 24;
+
+// The three prism meshes at MORPH_MAX_SIDES corners for shaders/morph.vert,
+// which gathers the corners onto any smaller side count. They are uploaded
+// once; changing sides only changes uniforms.
+std::vector<Mesh> generate_morph_prism(float length) {
+  TraceScope trace("generate_morph_prism", "geometry");
+  const int n = MORPH_MAX_SIDES;
+  glm::vec3 ring[MORPH_MAX_SIDES];
+  polygon_ring(n, length / 1.5, 0.0f, ring);
+  auto apex = glm::vec3(0.0f, 0.0f, length);
+
+  std::vector<MorphVertex> base(n), sides(n * 2 + 2), top(n);
+  std::vector<GLuint> cap_indices(n), side_indices(n * 2 + 2);
+  glm::vec3 basecolor = randcolor(), topcolor = randcolor();
+  for (int i = 0; i < n; i++) {
+    glm::vec3 up = ring[i] + glm::vec3(0.0f, 0.0f, length);
+    base[i] = {ring[i], basecolor, glm::vec2(0), ring[i], glm::vec2(i, 0)};
+    top[i] = {up, topcolor, glm::vec2(0), apex, glm::vec2(i, 1)};
+    cap_indices[i] = i;
+  }
+  // close the sides by repeating the first corner
+  glm::vec3 color = randcolor();
+  for (int i = 0; i < n * 2 + 2; i++) {
+    if (i % 4 == 0) color = randcolor();
+    int corner = i / 2 % n;
+    bool topvertex = (i % 2 == 1);
+    glm::vec3 v = topvertex ? top[corner].position : ring[corner];
+    sides[i] = {v, color, glm::vec2(0), topvertex ? apex : v,
+                glm::vec2(corner, topvertex)};
+    side_indices[i] = i;
+  }
+
+  std::vector<Mesh> shapes;
+  shapes.reserve(3);
+  shapes.emplace_back(base, cap_indices, GL_TRIANGLE_FAN, "shaders/morph.vert",
+                      "shaders/sides.frag", "textures/cement_wall.jpeg");
+  shapes.emplace_back(sides, side_indices, GL_TRIANGLE_STRIP,
+                      "shaders/morph.vert", "shaders/sides.frag",
+                      "textures/cement_wall.jpeg");
+  shapes.emplace_back(top, cap_indices, GL_TRIANGLE_FAN, "shaders/morph.vert",
+                      "shaders/sides.frag", "textures/cement_wall.jpeg");
+  return shapes;
+}
+
+// Animated change of side count for the morph prism: blends from the corner
+// angles on screen to another count over a few frames.
+struct SideMorph {
+  // angle of each corner slot when the blend started
+  float from[MORPH_MAX_SIDES];
+  int to = 3;
+  float blend = 1.0f;
+
+  SideMorph() { jump(3); }
+
+  // angle of corner slot `slot` on a polygon of `sides` corners, as in
+  // shaders/morph.vert
+  static float corner_angle(int slot, int sides) {
+    int corner = slot * sides / MORPH_MAX_SIDES;
+    return 2.0f * float(M_PI) * corner / sides;
+  }
+
+  // angle slot `slot` shows now
+  float angle(int slot) const {
+    float t = blend * blend * (3.0f - 2.0f * blend);  // smoothstep
+    return from[slot] + (corner_angle(slot, to) - from[slot]) * t;
+  }
+
+  // show `sides` at once
+  void jump(int sides) {
+    for (int i = 0; i < MORPH_MAX_SIDES; i++) from[i] = corner_angle(i, sides);
+    to = sides;
+    blend = 1.0f;
+  }
+
+  // start moving to `sides` from what is on screen, even mid-blend
+  void retarget(int sides) {
+    for (int i = 0; i < MORPH_MAX_SIDES; i++) from[i] = angle(i);
+    to = sides;
+    blend = 0.0f;
+  }
+
+  bool animating() const { return blend < 1.0f; }
+
+  void update() { blend = std::min(blend + 0.05f, 1.0f); }
+
+  void apply(Shader *shader) const {
+    shader->use();
+    shader->setInt("max_sides", MORPH_MAX_SIDES);
+    shader->setFloats("angles_from", from, MORPH_MAX_SIDES);
+    shader->setInt("sides_to", to);
+    shader->setFloat("sides_blend", blend);
+  }
+};
@@ -0,0 +1,356 @@
+#pragma once
+
+// standard
+#include <cmath>
+#include <vector>
+
+#include <engine.hpp>
+
+#include "ring.hpp"
+#include "tables.hpp"
+
+// Polyhedra built from a stack of rings around the z axis: prisms and
+// pyramids, antiprisms, twisted prisms, frusta, bipyramids and star prisms.
+// Every shape of a family with the same side count has the same topology,
+// so any two of them can be morphed into each other through position 2 and
+// the transition uniform of shaders/sides.vert.
+
+enum Family {
+  PRISM,
+  ANTIPRISM,
+  TWISTED_PRISM,
+  FRUSTUM,
+  BIPYRAMID,
+  STAR_PRISM,
+  FAMILY_COUNT
+};
+
+const char *family_name(Family f) {
+  switch (f) {
+    case PRISM:
+      return "prism";
+    case ANTIPRISM:
+      return "antiprism";
+    case TWISTED_PRISM:
+      return "twisted prism";
+    case FRUSTUM:
+      return "frustum";
+    case BIPYRAMID:
+      return "bipyramid";
+    default:
+      return "star prism";
+  }
+}
+
+// a ring of corners at height z, turned by `twist` radians
+struct Ring {
+  float radius;
+  float z;
+  float twist;
+};
+
+const int MAX_RINGS = 3;
+
+struct PolyhedronSpec {
+  int sides;
+  float star = 0.0f;  // inner radius over outer radius of star outlines
+  int ring_count = 0;
+  Ring rings[MAX_RINGS];
+};
+
+// whether the shapes have the same vertices and faces, so one can morph
+// into the other
+bool same_topology(const PolyhedronSpec &a, const PolyhedronSpec &b) {
+  return a.sides == b.sides && (a.star > 0) == (b.star > 0) &&
+         a.ring_count == b.ring_count;
+}
+
+// the n-sided member of a family, fitting the same bounds as the prism of
+// edge `length`
+PolyhedronSpec family_spec(Family f, int n, float length) {
+  float r = length / 1.5, h = length;
+  PolyhedronSpec s;
+  s.sides = n;
+  s.ring_count = 2;
+  s.rings[0] = {r, 0.0f, 0.0f};
+  s.rings[1] = {r, h, 0.0f};
+  switch (f) {
+    case ANTIPRISM:
+      s.rings[1].twist = M_PI / n;
+      break;
+    case TWISTED_PRISM:
+      s.rings[1].twist = M_PI / 2;
+      break;
+    case FRUSTUM:
+      s.rings[1].radius = r / 2;
+      break;
+    case BIPYRAMID:
+      s.ring_count = 3;
+      s.rings[0] = {0.0f, 0.0f, 0.0f};
+      s.rings[1] = {r, h / 2, 0.0f};
+      s.rings[2] = {0.0f, h, 0.0f};
+      break;
+    case STAR_PRISM:
+      s.star = 0.5f;
+      break;
+    default:
+      break;
+  }
+  return s;
+}
+
+// the shape collapsed onto a point of its axis: the top ring shrunk to the
+// apex, or for a bipyramid the waist pulled in to a needle
+PolyhedronSpec apex_of(PolyhedronSpec s) {
+  int last = s.ring_count - 1;
+  if (s.rings[last].radius == 0.0f && last > 0)
+    s.rings[last - 1].radius = 0.0f;
+  else
+    s.rings[last].radius = 0.0f;
+  return s;
+}
+
+void set_vertex(SidesVertex &v, const glm::vec3 &p, const glm::vec3 &color,
+                const glm::vec3 &morph) {
+  v = {p, color, glm::vec2(0), morph};
+}
+// mesh vertices have no morph target
+void set_vertex(MeshVertex &v, const glm::vec3 &p, const glm::vec3 &color,
+                const glm::vec3 &) {
+  v = {p, color, glm::vec2(0)};
+}
+
+// Appends triangles to vertex and index buffers owned by the caller, with
+// indices relative to the current shape's first vertex. Once the buffers
+// have grown to fit, emitting allocates nothing.
+template <typename Vertex>
+class Emitter {
+ public:
+  std::vector<Vertex> &vertices;
+  std::vector<GLuint> &indices;
+
+  Emitter(std::vector<Vertex> &vertices, std::vector<GLuint> &indices)
+      : vertices(vertices), indices(indices) {}
+
+  // start a new shape
+  void begin() { first = vertices.size(); }
+
+  // add a vertex at p morphing to m, returning its index
+  GLuint vertex(const glm::vec3 &p, const glm::vec3 &m,
+                const glm::vec3 &color) {
+    vertices.emplace_back();
+    set_vertex(vertices.back(), p, color, m);
+    return vertices.size() - 1 - first;
+  }
+
+  void triangle(GLuint a, GLuint b, GLuint c) {
+    indices.push_back(a);
+    indices.push_back(b);
+    indices.push_back(c);
+  }
+
+  // a flat colored triangle at p morphing to m
+  void triangle(const glm::vec3 *p, const glm::vec3 *m,
+                const glm::vec3 &color) {
+    GLuint a = vertex(p[0], m[0], color), b = vertex(p[1], m[1], color);
+    triangle(a, b, vertex(p[2], m[2], color));
+  }
+
+ private:
+  size_t first = 0;
+};
+
+// a shape and the shape it turns into as the transition uniform goes from 0
+// to 1; the two have the same topology
+struct MorphPair {
+  PolyhedronSpec from, to;
+};
+
+// `from` morphing into `to`, or into its own apex form when their topologies
+// differ
+MorphPair morph_pair(const PolyhedronSpec &from, const PolyhedronSpec &to) {
+  if (same_topology(from, to)) return {from, to};
+  return {from, apex_of(from)};
+}
+
+// working space of emit_polyhedron, owned by the caller so that emitting
+// many shapes allocates only until it has grown to fit
+struct PolyhedronScratch {
+  std::vector<glm::vec3> unit, from, to;
+};
+
+// corners of every ring of `s`, ring after ring, from the unit ring in `unit`
+void ring_corners(const PolyhedronSpec &s, std::vector<glm::vec3> &unit,
+                  std::vector<glm::vec3> &out) {
+  int corners = s.star > 0 ? 2 * s.sides : s.sides;
+  unit.resize(corners);
+  polygon_ring(corners, 1.0f, 0.0f, unit.data());
+  out.resize(s.ring_count * corners);
+  for (int k = 0; k < s.ring_count; k++) {
+    const Ring &r = s.rings[k];
+    float c = std::cos(r.twist), sn = std::sin(r.twist);
+    for (int j = 0; j < corners; j++) {
+      float radius = (s.star > 0 && (j & 1)) ? r.radius * s.star : r.radius;
+      glm::vec3 u = unit[j];
+      out[k * corners + j] = glm::vec3(radius * (c * u.x - sn * u.y),
+                                       radius * (sn * u.x + c * u.y), r.z);
+    }
+  }
+}
+
+// parts of a polyhedron, to emit them into separate meshes
+enum PolyhedronParts {
+  BANDS = 1,
+  BOTTOM_CAP = 2,
+  TOP_CAP = 4,
+  WHOLE = BANDS | BOTTOM_CAP | TOP_CAP
+};
+
+// Emit `parts` of `m.from` as flat shaded triangles whose position 2 is the
+// matching point of `m.to`. Each band between two rings is a strip of quads,
+// and the end rings are closed by triangles around a center point, which
+// also handles star outlines.
+template <typename Vertex>
+void emit_polyhedron(Emitter<Vertex> &e, PolyhedronScratch &scratch,
+                     const MorphPair &m, int parts = WHOLE) {
+  const PolyhedronSpec &from = m.from, &to = m.to;
+  if (!same_topology(from, to)) die("polyhedron morph targets differ");
+  std::vector<glm::vec3> &a = scratch.from, &b = scratch.to;
+  ring_corners(from, scratch.unit, a);
+  ring_corners(to, scratch.unit, b);
+  int corners = from.star > 0 ? 2 * from.sides : from.sides;
+  auto at = [&](std::vector<glm::vec3> &v, int k, int j) {
+    return v[k * corners + j % corners];
+  };
+  e.begin();
+
+  // bands
+  for (int k = 0; (parts & BANDS) && k + 1 < from.ring_count; k++) {
+    for (int j = 0; j < corners; j++) {
+      glm::vec3 color = randcolor();
+      glm::vec3 p1[] = {at(a, k, j), at(a, k, j + 1), at(a, k + 1, j + 1)};
+      glm::vec3 m1[] = {at(b, k, j), at(b, k, j + 1), at(b, k + 1, j + 1)};
+      glm::vec3 p2[] = {at(a, k, j), at(a, k + 1, j + 1), at(a, k + 1, j)};
+      glm::vec3 m2[] = {at(b, k, j), at(b, k + 1, j + 1), at(b, k + 1, j)};
+      e.triangle(p1, m1, color);
+      e.triangle(p2, m2, color);
+    }
+  }
+
+  // caps, facing out
+  int last = from.ring_count - 1;
+  for (int cap = 0; cap < 2; cap++) {
+    if (!(parts & (cap ? TOP_CAP : BOTTOM_CAP))) continue;
+    int k = cap ? last : 0;
+    glm::vec3 color = randcolor();
+    glm::vec3 pc(0.0f, 0.0f, from.rings[k].z), mc(0.0f, 0.0f, to.rings[k].z);
+    for (int j = 0; j < corners; j++) {
+      int j1 = cap ? j : j + 1, j2 = cap ? j + 1 : j;
+      glm::vec3 p[] = {pc, at(a, k, j1), at(a, k, j2)};
+      glm::vec3 m[] = {mc, at(b, k, j1), at(b, k, j2)};
+      e.triangle(p, m, color);
+    }
+  }
+}
+
+// Many polyhedra emitted into one pair of buffers and uploaded as a single
+// arena allocation. Meshes draw their entry through Mesh::show().
+template <typename Vertex>
+class PolyhedronCatalog {
+ public:
+  ~PolyhedronCatalog() { arena.release(allocation); }
+
+  // add `parts` of a morphing shape, returning its entry
+  int add(const MorphPair &m, int parts = WHOLE) {
+    Entry entry;
+    entry.first_vertex = vertices.size();
+    entry.first_index = indices.size();
+    emit_polyhedron(emitter, scratch, m, parts);
+    entry.index_count = indices.size() - entry.first_index;
+    for (size_t i = entry.first_vertex; i < vertices.size(); i++)
+      vertices[i].extend(entry.bounds);
+    entries.push_back(entry);
+    return entries.size() - 1;
+  }
+
+  // upload everything added so far, replacing an earlier upload
+  void upload() {
+    TraceScope trace("catalog upload", "geometry");
+    arena.release(allocation);
+    PackedGeometry g = pack_geometry(Span<const Vertex>(vertices), indices);
+    allocation = arena.allocate(*g.format, g.vertices, g.vertex_count,
+                                g.index_type, g.indices, g.index_count);
+  }
+
+  ArenaRange range(int entry) const {
+    const Entry &e = entries[entry];
+    return allocation.range(e.first_index, e.index_count, e.first_vertex);
+  }
+
+  const AABB &bounds(int entry) const { return entries[entry].bounds; }
+
+  int size() const { return entries.size(); }
+
+ private:
+  struct Entry {
+    GLuint first_vertex, first_index, index_count;
+    AABB bounds;
+  };
+  std::vector<Vertex> vertices;
+  std::vector<GLuint> indices;
+  Emitter<Vertex> emitter{vertices, indices};
+  PolyhedronScratch scratch;
+  std::vector<Entry> entries;
+  ArenaAllocation allocation;
+};
+
+// the catalog of every family but the plain prism for the side counts of
+// tables.hpp, each morphing to its apex form
+int catalog_entry(Family f, int n) {
+  return (f - 1) * (TABLE_MAX_SIDES - TABLE_MIN_SIDES + 1) +
+         (n - TABLE_MIN_SIDES);
+}
+
+void build_family_catalog(PolyhedronCatalog<SidesVertex> &catalog,
+                          float length) {
+  TraceScope trace("family catalog", "geometry");
+  for (int f = PRISM + 1; f < FAMILY_COUNT; f++)
+    for (int n = TABLE_MIN_SIDES; n <= TABLE_MAX_SIDES; n++) {
+      PolyhedronSpec s = family_spec(Family(f), n, length);
+      catalog.add(morph_pair(s, apex_of(s)));
+    }
+  catalog.upload();
+}
+
+// vertex and index data of one polyhedron mesh, with the scratch to emit it.
+// Emitting into the same buffers again reuses their storage.
+template <typename Vertex>
+struct PolyhedronBuffers {
+  std::vector<Vertex> vertices;
+  std::vector<GLuint> indices;
+  PolyhedronScratch scratch;
+
+  // replace the contents by `parts` of `m`
+  void emit(const MorphPair &m, int parts = WHOLE) {
+    vertices.clear();
+    indices.clear();
+    Emitter<Vertex> e(vertices, indices);
+    emit_polyhedron(e, scratch, m, parts);
+  }
+};
+
+// Point `mesh` at the n-sided member of family f. Side counts the catalog
+// has are drawn from there. Any other count is emitted into `buffers`, then
+// copied into the mesh's own storage.
+void show_family(Mesh &mesh, const PolyhedronCatalog<SidesVertex> &catalog,
+                 PolyhedronBuffers<SidesVertex> &buffers, Family f, int n,
+                 float length) {
+  if (n >= TABLE_MIN_SIDES && n <= TABLE_MAX_SIDES) {
+    int e = catalog_entry(f, n);
+    mesh.show(catalog.range(e), catalog.bounds(e));
+    return;
+  }
+  PolyhedronSpec s = family_spec(f, n, length);
+  buffers.emit(morph_pair(s, apex_of(s)));
+  mesh.reshape(buffers.vertices, buffers.indices);
+}
@@ -1,135 +1,115 @@
 #include <engine.hpp>
 
-std::vector<float> flatten(std::vector<glm::vec3> vertices,
-                           glm::vec3 color = randcolor()) {
-  std::vector<float> points;
-  for (auto &v : vertices) {
-    // position
-    points.push_back(v.x);
-    points.push_back(v.y);
-    points.push_back(v.z);
-    // color
-    points.push_back(color.r);
-    points.push_back(color.g);
-    points.push_back(color.b);
-    // texture
-    points.push_back(0);
-    points.push_back(0);
-  }
+#include "polyhedron.hpp"
+
+std::vector<MeshVertex> flatten(const std::vector<glm::vec3> &vertices,
+                                glm::vec3 color = randcolor()) {
+  std::vector<MeshVertex> points;
+  points.reserve(vertices.size());
+  for (auto &v : vertices) points.push_back({v, color, glm::vec2(0)});
   return points;
 }
 
-std::vector<Mesh *> generate_prism(int sides, float length,
-                                    glm::vec3 basecolor = randcolor()) {
-  // Shader *shader = new Shader("shaders/shader.frag", "shaders/shader.vert");
-  // Texture *texture = new Texture("textures/cement_wall.jpeg");
+// vertex and index data of the three meshes of a prism: the base, drawn by
+// shaders/shader.vert, and the sides and top, which turn into a pyramid.
+// Rebuilding into the same PrismGeometry reuses its storage.
+struct PrismGeometry {
+  PolyhedronBuffers<MeshVertex> base;
+  PolyhedronBuffers<SidesVertex> sides, top;
+};
 
-  std::vector<Mesh *> shapes;
+// the prism of edge `length` morphing into its pyramid
+MorphPair prism_morph(int sides, float length) {
+  PolyhedronSpec s = family_spec(PRISM, sides, length);
+  return morph_pair(s, apex_of(s));
+}
 
-  float angle = 2 * M_PI / sides;
-  auto ray = glm::vec4(length / 1.5, 0, 0, 1);
-  auto axis = glm::vec3(0, 0, 1);
-  auto rot = glm::rotate(glm::mat4(1), angle, axis);
+void build_prism(PrismGeometry &g, int sides, float length) {
+  TraceScope trace("build_prism", "geometry");
+  MorphPair m = prism_morph(sides, length);
+  g.base.emit(m, BOTTOM_CAP);
+  g.sides.emit(m, BANDS);
+  g.top.emit(m, TOP_CAP);
+}
 
-  std::vector<glm::vec3> vertices;
-  std::vector<GLuint> indices;
+// The prisms of the side counts in tables.hpp, all uploaded together at
+// startup. Meshes of those side counts draw straight from here, so stepping
+// through them computes and uploads nothing.
+class PrismTables {
+ public:
+  PolyhedronCatalog<MeshVertex> base;
+  PolyhedronCatalog<SidesVertex> sides, top;
 
-  // for base
-  for (int i = 0; i < sides; i++) {
-    indices.push_back(i);
-    vertices.push_back(ray);
-    ray = rot * ray;
+  static bool has(int n) {
+    return n >= TABLE_MIN_SIDES && n <= TABLE_MAX_SIDES;
   }
 
-  shapes.push_back(
-      new Mesh(flatten(vertices, basecolor), indices, GL_TRIANGLE_FAN));
-
-  // for sides
-  std::vector<glm::vec3> vertices2;
-  for (auto &v : vertices) {
-    vertices2.push_back(v);
-    vertices2.push_back(glm::vec3(v.x, v.y, v.z + length));
+  // emit every prism like build_prism does and upload them; their rings
+  // come from polygon_ring, which reads the compiled ring table
+  void upload(float length) {
+    TraceScope trace("prism tables", "geometry");
+    for (int n = TABLE_MIN_SIDES; n <= TABLE_MAX_SIDES; n++) {
+      MorphPair m = prism_morph(n, length);
+      base.add(m, BOTTOM_CAP);
+      sides.add(m, BANDS);
+      top.add(m, TOP_CAP);
+    }
+    base.upload();
+    sides.upload();
+    top.upload();
   }
-  // close the sides
-  auto v = vertices.front();
-  vertices2.push_back(v);
-  vertices2.push_back(glm::vec3(v.x, v.y, v.z + length));
-
-  std::vector<GLuint> indices2(sides * 2 + 2);
-  std::iota(indices2.begin(), indices2.end(), 0);
 
-  std::vector<float> points;
-  int i = 0;
-  glm::vec3 color = randcolor();
-  auto top = glm::vec3(0.0f, 0.0f, length);
-  for (auto &v : vertices2) {
-    // change color after every quad
-    if (i % 4 == 0) color = randcolor();
-    // position
-    points.push_back(v.x);
-    points.push_back(v.y);
-    points.push_back(v.z);
-    // color
-    points.push_back(color.r);
-    points.push_back(color.g);
-    points.push_back(color.b);
-    // texture
-    points.push_back(0);
-    points.push_back(0);
-    // position 2
-    bool topvertex = (i % 2 == 1);
-    points.push_back(topvertex ? top.x : v.x);
-    points.push_back(topvertex ? top.y : v.y);
-    points.push_back(topvertex ? top.z : v.z);
-    i++;
+  // point the base, sides and top meshes at the n-sided prism
+  void show(Mesh &base_mesh, Mesh &sides_mesh, Mesh &top_mesh, int n) const {
+    int e = n - TABLE_MIN_SIDES;
+    base_mesh.show(base.range(e), base.bounds(e));
+    sides_mesh.show(sides.range(e), sides.bounds(e));
+    top_mesh.show(top.range(e), top.bounds(e));
   }
+};
 
-  shapes.push_back(new Mesh(points, indices2, GL_TRIANGLE_STRIP,
-                             "shaders/sides.vert", "shaders/sides.frag",
-                             "textures/cement_wall.jpeg",
-                             {
-                                 {3, GL_FLOAT},  // position
-                                 {3, GL_FLOAT},  // color
-                                 {2, GL_FLOAT},  // texture
-                                 {3, GL_FLOAT},  // position 2
-                             }));
-
-  // for top
-  // use the same vertices as the base but move them up
-  for (auto &v : vertices) {
-    v.z += length;
+// the three meshes of a prism; side counts in `tables` draw from there, with
+// the colors picked at upload
+std::vector<Mesh> generate_prism(const PrismTables &tables, int sides,
+                                 float length) {
+  std::vector<Mesh> shapes;
+  shapes.reserve(3);
+  if (PrismTables::has(sides)) {
+    int e = sides - TABLE_MIN_SIDES;
+    shapes.emplace_back(tables.base.range(e));
+    shapes.emplace_back(tables.sides.range(e), GL_TRIANGLES,
+                        "shaders/sides.vert", "shaders/sides.frag",
+                        "textures/cement_wall.jpeg");
+    shapes.emplace_back(tables.top.range(e), GL_TRIANGLES,
+                        "shaders/sides.vert", "shaders/sides.frag",
+                        "textures/cement_wall.jpeg");
+    tables.show(shapes[0], shapes[1], shapes[2], sides);
+    return shapes;
   }
 
-  std::vector<float> points2;
-  glm::vec3 color2 = randcolor();
-  i = 0;
-  for (auto &v : vertices) {
-    // position
-    points2.push_back(v.x);
-    points2.push_back(v.y);
-    points2.push_back(v.z);
-    // color
-    points2.push_back(color2.r);
-    points2.push_back(color2.g);
-    points2.push_back(color2.b);
-    // texture
-    points2.push_back(0);
-    points2.push_back(0);
-    // position 2
-    points2.push_back(top.x);
-    points2.push_back(top.y);
-    points2.push_back(top.z);
-    i++;
+  PrismGeometry g;
+  build_prism(g, sides, length);
+  shapes.emplace_back(g.base.vertices, g.base.indices);
+  shapes.emplace_back(g.sides.vertices, g.sides.indices, GL_TRIANGLES,
+                      "shaders/sides.vert", "shaders/sides.frag",
+                      "textures/cement_wall.jpeg");
+  shapes.emplace_back(g.top.vertices, g.top.indices, GL_TRIANGLES,
+                      "shaders/sides.vert", "shaders/sides.frag",
+                      "textures/cement_wall.jpeg");
+  return shapes;
+}
+
+// rebuild the meshes made by generate_prism for another side count, in place
+// and through `g`; their state, shaders and textures stay
+void update_prism(const PrismTables &tables, PrismGeometry &g,
+                  std::vector<Mesh *> &shapes, int sides, float length) {
+  if (PrismTables::has(sides)) {
+    tables.show(*shapes[0], *shapes[1], *shapes[2], sides);
+    return;
   }
-  shapes.push_back(new Mesh(points2, indices, GL_TRIANGLE_FAN,
-                             "shaders/sides.vert", "shaders/sides.frag",
-                             "textures/cement_wall.jpeg",
-                             {
-                                 {3, GL_FLOAT},  // position
-                                 {3, GL_FLOAT},  // color
-                                 {2, GL_FLOAT},  // texture
-                                 {3, GL_FLOAT},  // position 2
-                             }));
 
-  return shapes;
-}
\ No newline at end of file
+  build_prism(g, sides, length);
+  shapes[0]->reshape(g.base.vertices, g.base.indices);
+  shapes[1]->reshape(g.sides.vertices, g.sides.indices);
+  shapes[2]->reshape(g.top.vertices, g.top.indices);
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+// standard
+#include <cmath>
+#include <cstdint>
+
+// simd
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// glm
+#include <glm/glm.hpp>
+
+// helpers
+#include "tables.hpp"
+
+// angles evaluated per kernel call; several vectors in flight hide the
+// latency of the polynomial chains
+const int RING_LANES = 8;
+
+// sin and cos of RING_LANES angles in [0, pi/4], as Taylor polynomials in
+// double precision. Their error there is below 1e-11, far under half a float
+// ulp, so once rounded to float the results are within 1 ulp of the true
+// values.
+void ring_sincos_kernel(const double *x, double *s, double *c) {
+  // 1/n! for n = 2..13
+  const double f2 = 1.0 / 2, f3 = 1.0 / 6, f4 = 1.0 / 24, f5 = 1.0 / 120,
+               f6 = 1.0 / 720, f7 = 1.0 / 5040, f8 = 1.0 / 40320,
+               f9 = 1.0 / 362880, f10 = 1.0 / 3628800, f11 = 1.0 / 39916800,
+               f12 = 1.0 / 479001600;
+#if defined(__AVX__)
+#define RING_SET(v) _mm256_set1_pd(v)
+#define RING_MUL _mm256_mul_pd
+#define RING_ADD _mm256_add_pd
+#define RING_SUB _mm256_sub_pd
+  const int width = 4;
+  typedef __m256d lane;
+  auto load = [](const double *p) { return _mm256_loadu_pd(p); };
+  auto store = [](double *p, lane v) { _mm256_storeu_pd(p, v); };
+#elif defined(__SSE2__)
+#define RING_SET(v) _mm_set1_pd(v)
+#define RING_MUL _mm_mul_pd
+#define RING_ADD _mm_add_pd
+#define RING_SUB _mm_sub_pd
+  const int width = 2;
+  typedef __m128d lane;
+  auto load = [](const double *p) { return _mm_loadu_pd(p); };
+  auto store = [](double *p, lane v) { _mm_storeu_pd(p, v); };
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define RING_SET(v) vdupq_n_f64(v)
+#define RING_MUL vmulq_f64
+#define RING_ADD vaddq_f64
+#define RING_SUB vsubq_f64
+  const int width = 2;
+  typedef float64x2_t lane;
+  auto load = [](const double *p) { return vld1q_f64(p); };
+  auto store = [](double *p, lane v) { vst1q_f64(p, v); };
+#else
+#define RING_SET(v) (v)
+#define RING_MUL(a, b) ((a) * (b))
+#define RING_ADD(a, b) ((a) + (b))
+#define RING_SUB(a, b) ((a) - (b))
+  const int width = 1;
+  typedef double lane;
+  auto load = [](const double *p) { return *p; };
+  auto store = [](double *p, lane v) { *p = v; };
+#endif
+  for (int i = 0; i < RING_LANES; i += width) {
+    lane v = load(x + i);
+    lane v2 = RING_MUL(v, v);
+    // sin x = x (1 - x^2/3! + x^4/5! - ...), by Horner in x^2
+    lane p = RING_SET(f11);
+    p = RING_SUB(RING_SET(f9), RING_MUL(v2, p));
+    p = RING_SUB(RING_SET(f7), RING_MUL(v2, p));
+    p = RING_SUB(RING_SET(f5), RING_MUL(v2, p));
+    p = RING_SUB(RING_SET(f3), RING_MUL(v2, p));
+    p = RING_SUB(RING_SET(1.0), RING_MUL(v2, p));
+    store(s + i, RING_MUL(v, p));
+    // cos x = 1 - x^2/2! + x^4/4! - ...
+    lane q = RING_SET(f12);
+    q = RING_SUB(RING_SET(f10), RING_MUL(v2, q));
+    q = RING_SUB(RING_SET(f8), RING_MUL(v2, q));
+    q = RING_SUB(RING_SET(f6), RING_MUL(v2, q));
+    q = RING_SUB(RING_SET(f4), RING_MUL(v2, q));
+    q = RING_SUB(RING_SET(f2), RING_MUL(v2, q));
+    q = RING_SUB(RING_SET(1.0), RING_MUL(v2, q));
+    store(c + i, q);
+  }
+#undef RING_SET
+#undef RING_MUL
+#undef RING_ADD
+#undef RING_SUB
+}
+
+// Writes the `sides` corners of a regular polygon of circumradius `radius`
+// around the z axis, starting on +x and going counter-clockwise, at height
+// `z`. Angle i is kept exactly as an octant and an integer remainder,
+// 2 pi i / sides = (octant + rest / sides) pi/4, and advanced with integer
+// steps, so there is no drift however many sides there are.
+//
+// Rings of up to TABLE_MAX_SIDES sides are scaled from the compiled tables:
+// the kernel would spend most of its lanes past the last corner there.
+void polygon_ring(int sides, float radius, float z, glm::vec3 *out) {
+  if (sides >= TABLE_MIN_SIDES && sides <= TABLE_MAX_SIDES) {
+    const double(*xy)[2] = &ring_table.xy[table_offset(sides, 1, 0)];
+    for (int i = 0; i < sides; i++)
+      out[i] = glm::vec3(float(radius * xy[i][0]), float(radius * xy[i][1]),
+                         z);
+    return;
+  }
+  const double step = 0.78539816339744830962 / sides;  // pi/4 per side
+  double x[RING_LANES], s[RING_LANES], c[RING_LANES];
+  int octant[RING_LANES];
+  int k = 0;
+  int64_t rest = 0;
+  for (int base = 0; base < sides; base += RING_LANES) {
+    int lanes = sides - base < RING_LANES ? sides - base : RING_LANES;
+    for (int l = 0; l < RING_LANES; l++) {
+      octant[l] = k;
+      // odd octants mirror the even ones: measure from the next multiple of
+      // pi/4 instead
+      x[l] = double(k & 1 ? sides - rest : rest) * step;
+      rest += 8;
+      while (rest >= sides) rest -= sides, k++;
+    }
+    ring_sincos_kernel(x, s, c);
+    for (int l = 0; l < lanes; l++) {
+      // sin and cos within the quadrant, then rotated by the quadrant
+      int k = octant[l];
+      double qs = (k & 1) ? c[l] : s[l];
+      double qc = (k & 1) ? s[l] : c[l];
+      double sn, cs;
+      switch ((k >> 1) & 3) {
+        case 0: sn = qs, cs = qc; break;
+        case 1: sn = qc, cs = -qs; break;
+        case 2: sn = -qs, cs = -qc; break;
+        default: sn = -qc, cs = qs; break;
+      }
+      out[base + l] = glm::vec3(float(radius * cs), float(radius * sn), z);
+    }
+  }
+}
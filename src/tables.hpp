@@ -0,0 +1,74 @@
+#pragma once
+
+// Unit rings for the side counts the UI visits most, computed by the compiler
+// and embedded in the binary.
+
+// side counts covered by the tables
+const int TABLE_MIN_SIDES = 3;
+const int TABLE_MAX_SIDES = 12;
+
+// sin and cos on [0, pi/4] by Taylor series, as in ring_sincos_kernel
+constexpr double table_sin(double x) {
+  double term = x, sum = x;
+  for (int n = 2; n < 16; n += 2) {
+    term *= -x * x / (n * (n + 1));
+    sum += term;
+  }
+  return sum;
+}
+constexpr double table_cos(double x) {
+  double term = 1.0, sum = 1.0;
+  for (int n = 1; n < 16; n += 2) {
+    term *= -x * x / (n * (n + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+// first table entry of each side count, when every count from
+// TABLE_MIN_SIDES on takes `per_side` entries per side plus `extra`
+constexpr int table_offset(int sides, int per_side, int extra) {
+  int offset = 0;
+  for (int n = TABLE_MIN_SIDES; n < sides; n++) offset += n * per_side + extra;
+  return offset;
+}
+
+// ring entries: one per corner
+const int RING_TABLE_SIZE = table_offset(TABLE_MAX_SIDES + 1, 1, 0);
+
+struct RingTable {
+  // unit circle corners of each side count, starting on +x and going
+  // counter-clockwise, in double so rings of any radius round once
+  double xy[RING_TABLE_SIZE][2] = {};
+};
+
+// the angle of corner i is reduced exactly to an octant as in polygon_ring
+constexpr RingTable make_ring_table() {
+  const double quarter_pi = 0.78539816339744830962;
+  RingTable t;
+  for (int sides = TABLE_MIN_SIDES; sides <= TABLE_MAX_SIDES; sides++) {
+    int ring = table_offset(sides, 1, 0);
+    for (int i = 0; i < sides; i++) {
+      int k = 8 * i / sides, rest = 8 * i % sides;
+      if (k & 1) rest = sides - rest;
+      double x = double(rest) / sides * quarter_pi;
+      double qs = (k & 1) ? table_cos(x) : table_sin(x);
+      double qc = (k & 1) ? table_sin(x) : table_cos(x);
+      double s = qs, c = qc;
+      if ((k >> 1) == 1) s = qc, c = -qs;
+      if ((k >> 1) == 2) s = -qs, c = -qc;
+      if ((k >> 1) == 3) s = -qc, c = qs;
+      t.xy[ring + i][0] = c;
+      t.xy[ring + i][1] = s;
+    }
+  }
+  return t;
+}
+
+constexpr RingTable ring_table = make_ring_table();
+
+static_assert(ring_table.xy[0][0] == 1.0 && ring_table.xy[0][1] == 0.0,
+              "rings start on +x");
+static_assert(ring_table.xy[table_offset(4, 1, 0) + 1][0] == 0.0 &&
+                  ring_table.xy[table_offset(4, 1, 0) + 1][1] == 1.0,
+              "square corners lie on the axes");
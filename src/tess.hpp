@@ -0,0 +1,75 @@
+#pragma once
+
+// standard
+#include <vector>
+
+#include <engine.hpp>
+
+// sides drawn by one patch; GL only guarantees tessellation levels up to 64.
+// SECTOR_SIDES in shaders/tess.tesc must match.
+const int TESS_SECTOR_SIDES = 64;
+
+// side counts above this use the tessellated prism when the context has
+// tessellation shaders
+const int TESS_MIN_SIDES = 64;
+
+bool tessellation_available() {
+#ifdef GL_VERSION_4_0
+  return GLAD_GL_VERSION_4_0;
+#else
+  return false;
+#endif
+}
+
+// Patches of a prism with `sides` sides, for shaders/tess.tesc: the base,
+// walls and top are each split into sectors of TESS_SECTOR_SIDES sides, one
+// patch of one vertex per sector. The control shader picks how many sides
+// to draw from the size of the prism on screen and drops the sectors it
+// does not need, so a 10000-sided prism far away draws a few triangles.
+void tess_patches(int sides, float length, std::vector<PatchVertex> &patches,
+                  std::vector<GLuint> &indices) {
+  int sectors = (sides + TESS_SECTOR_SIDES - 1) / TESS_SECTOR_SIDES;
+  glm::vec3 shape(length / 1.5, length, sides);
+  patches.clear();
+  indices.clear();
+  for (int part = 0; part < 3; part++)
+    for (int s = 0; s < sectors; s++) {
+      indices.push_back(patches.size());
+      patches.push_back({shape, glm::vec2(s, part)});
+    }
+}
+
+Mesh generate_tess_prism(int sides, float length) {
+  TraceScope trace("generate_tess_prism", "geometry");
+  std::vector<PatchVertex> patches;
+  std::vector<GLuint> indices;
+  tess_patches(sides, length, patches, indices);
+#ifdef GL_VERSION_4_0
+  // no other mesh draws patches, so this is set once
+  glPatchParameteri(GL_PATCH_VERTICES, 1);
+  Mesh mesh(patches, indices, GL_PATCHES,
+            resources.shader("shaders/tess.vert", "shaders/sides.frag",
+                             "shaders/tess.tesc", "shaders/tess.tese"),
+            resources.texture("textures/cement_wall.jpeg"));
+  mesh.shader->use();
+  mesh.shader->setFloat("pixel_error", 0.5f);
+  return mesh;
+#else
+  die("Tessellation needs OpenGL 4.0");
+  return Mesh(patches, indices);
+#endif
+}
+
+// patches of the tessellated prism, kept by the caller so that rebuilding
+// allocates only until the buffers have grown to fit
+struct TessBuffers {
+  std::vector<PatchVertex> patches;
+  std::vector<GLuint> indices;
+};
+
+// rebuild the patches for another side count, in place
+void update_tess_prism(Mesh &mesh, TessBuffers &buffers, int sides,
+                       float length) {
+  tess_patches(sides, length, buffers.patches, buffers.indices);
+  mesh.reshape(buffers.patches, buffers.indices);
+}
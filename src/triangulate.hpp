@@ -0,0 +1,317 @@
+#pragma once
+
+// standard
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <vector>
+
+// glm
+#include <glm/glm.hpp>
+
+// A simple polygon: the outline, then any holes. Contours can run either way
+// round and must not touch each other.
+typedef std::vector<std::vector<glm::vec2>> Contours;
+
+// Triangulates simple polygons with holes in O(n log n): a plane sweep adds
+// diagonals that split the polygon into y-monotone pieces, and each piece is
+// then triangulated in linear time.
+class Triangulator {
+ public:
+  // append counter-clockwise triangles to `triangles`, as indices into the
+  // points of `contours` taken in order. Returns false when the contours are
+  // not a simple polygon.
+  bool triangulate(const Contours &contours,
+                   std::vector<unsigned int> &triangles) {
+    out = &triangles;
+    if (!load(contours)) return false;
+    if (!partition()) return false;
+    split_faces();
+    return true;
+  }
+
+ private:
+  struct Point {
+    double x, y;
+  };
+  enum Kind { START, END, SPLIT, MERGE, REGULAR };
+
+  // orders status edges by where they cross the sweep line, left to right.
+  // Edge -1 stands for the point being looked up.
+  struct EdgeLess {
+    const Triangulator *t;
+    bool operator()(int a, int b) const { return t->x_at(a) < t->x_at(b); }
+  };
+
+  std::vector<Point> points;
+  // neighbours along the contours, with the interior on the left
+  std::vector<int> next, prev;
+  // vertices from top to bottom
+  std::vector<int> order;
+  std::vector<Kind> kind;
+  // lowest vertex above each status edge i -> next[i] that can see it
+  std::vector<int> helper;
+  std::set<int, EdgeLess> status{EdgeLess{this}};
+  std::vector<std::set<int, EdgeLess>::iterator> where;
+  double sweep_x = 0, sweep_y = 0;
+
+  // half edges: contour edges, then both ways along each diagonal. The ones
+  // leaving a vertex are edges[first[v]] to edges[first[v + 1]].
+  std::vector<int> from, to, first, edges;
+  std::vector<bool> used;
+
+  std::vector<int> face, chain, sorted, stack;
+  std::vector<unsigned int> *out = NULL;
+
+  // whether vertex a is passed by the sweep before b
+  bool above(int a, int b) const {
+    const Point &p = points[a], &q = points[b];
+    return p.y > q.y || (p.y == q.y && p.x < q.x);
+  }
+
+  double orient(int a, int b, int c) const {
+    const Point &p = points[a], &q = points[b], &r = points[c];
+    return (q.x - p.x) * (r.y - p.y) - (q.y - p.y) * (r.x - p.x);
+  }
+
+  // where edge e crosses the sweep line; horizontal edges are only in the
+  // status while the sweep is at their left end
+  double x_at(int e) const {
+    if (e < 0) return sweep_x;
+    const Point &p = points[e], &q = points[next[e]];
+    if (p.y == q.y) return std::min(p.x, q.x);
+    return p.x + (sweep_y - p.y) * (q.x - p.x) / (q.y - p.y);
+  }
+
+  bool load(const Contours &contours) {
+    points.clear();
+    next.clear();
+    prev.clear();
+    for (size_t c = 0; c < contours.size(); c++) {
+      const std::vector<glm::vec2> &contour = contours[c];
+      int n = contour.size(), base = points.size();
+      if (n < 3) return false;
+      double area = 0;
+      for (int i = 0; i < n; i++) {
+        const glm::vec2 &p = contour[i], &q = contour[(i + 1) % n];
+        area += double(p.x) * q.y - double(q.x) * p.y;
+        points.push_back({p.x, p.y});
+      }
+      // the outline runs counter-clockwise and holes clockwise
+      bool forward = (area > 0) == (c == 0);
+      for (int i = 0; i < n; i++) {
+        int after = base + (i + 1) % n, before = base + (i + n - 1) % n;
+        next.push_back(forward ? after : before);
+        prev.push_back(forward ? before : after);
+      }
+    }
+    return points.size() > 0;
+  }
+
+  void classify() {
+    int n = points.size();
+    kind.resize(n);
+    for (int v = 0; v < n; v++) {
+      bool prev_above = above(prev[v], v), next_above = above(next[v], v);
+      bool convex = orient(prev[v], v, next[v]) > 0;
+      if (!prev_above && !next_above)
+        kind[v] = convex ? START : SPLIT;
+      else if (prev_above && next_above)
+        kind[v] = convex ? END : MERGE;
+      else
+        kind[v] = REGULAR;
+    }
+  }
+
+  // false when another edge crosses the sweep line at the same point
+  bool insert(int e, int v) {
+    auto inserted = status.insert(e);
+    where[e] = inserted.first;
+    helper[e] = v;
+    return inserted.second;
+  }
+
+  // the status edge directly left of the sweep point
+  int left_edge() {
+    auto it = status.lower_bound(-1);
+    if (it == status.begin()) return -1;
+    return *--it;
+  }
+
+  // add a diagonal from v to the helper of e if that is a merge vertex
+  void resolve(int e, int v) {
+    if (kind[helper[e]] == MERGE) diagonal(v, helper[e]);
+  }
+
+  void diagonal(int a, int b) {
+    from.push_back(a), to.push_back(b);
+    from.push_back(b), to.push_back(a);
+  }
+
+  // sweep top to bottom, adding diagonals at split and merge vertices
+  bool partition() {
+    int n = points.size();
+    classify();
+    order.resize(n);
+    for (int i = 0; i < n; i++) order[i] = i;
+    std::sort(order.begin(), order.end(),
+              [this](int a, int b) { return above(a, b); });
+
+    from.resize(n);
+    to.resize(n);
+    for (int v = 0; v < n; v++) from[v] = v, to[v] = next[v];
+    status.clear();
+    helper.assign(n, -1);
+    where.resize(n);
+
+    for (int v : order) {
+      sweep_x = points[v].x;
+      sweep_y = points[v].y;
+      int e = prev[v], left;
+      switch (kind[v]) {
+        case START:
+          if (!insert(v, v)) return false;
+          break;
+        case END:
+          resolve(e, v);
+          status.erase(where[e]);
+          break;
+        case SPLIT:
+          if ((left = left_edge()) < 0) return false;
+          diagonal(v, helper[left]);
+          helper[left] = v;
+          if (!insert(v, v)) return false;
+          break;
+        case MERGE:
+          resolve(e, v);
+          status.erase(where[e]);
+          if ((left = left_edge()) < 0) return false;
+          resolve(left, v);
+          helper[left] = v;
+          break;
+        case REGULAR:
+          if (above(prev[v], v)) {
+            // on a left chain: the interior is to the right
+            resolve(e, v);
+            status.erase(where[e]);
+            if (!insert(v, v)) return false;
+          } else {
+            if ((left = left_edge()) < 0) return false;
+            resolve(left, v);
+            helper[left] = v;
+          }
+          break;
+      }
+    }
+    return true;
+  }
+
+  // clockwise angle from direction v -> u to v -> w, in (0, 2 pi]
+  double turn(int v, int u, int w) const {
+    const Point &p = points[v], &a = points[u], &b = points[w];
+    double angle = std::atan2(a.y - p.y, a.x - p.x) -
+                   std::atan2(b.y - p.y, b.x - p.x);
+    const double two_pi = 6.28318530717958647692;
+    while (angle <= 0) angle += two_pi;
+    while (angle > two_pi) angle -= two_pi;
+    return angle;
+  }
+
+  // the half edge after h around the face on its left: the first edge
+  // clockwise from the way back among those leaving its end
+  int after(int h) const {
+    int v = to[h], best = edges[first[v]];
+    if (first[v + 1] - first[v] == 1) return best;
+    double best_turn = 10;
+    for (int i = first[v]; i < first[v + 1]; i++) {
+      double t = turn(v, from[h], to[edges[i]]);
+      if (t < best_turn) best_turn = t, best = edges[i];
+    }
+    return best;
+  }
+
+  // walk the faces cut out by the diagonals and triangulate each
+  void split_faces() {
+    int n = points.size(), count = from.size();
+    first.assign(n + 1, 0);
+    for (int h = 0; h < count; h++) first[from[h] + 1]++;
+    for (int v = 0; v < n; v++) first[v + 1] += first[v];
+    edges.resize(count);
+    std::vector<int> fill(first.begin(), first.end() - 1);
+    for (int h = 0; h < count; h++) edges[fill[from[h]]++] = h;
+
+    used.assign(count, false);
+    chain.resize(n);
+    for (int start = 0; start < count; start++) {
+      if (used[start]) continue;
+      face.clear();
+      for (int h = start; !used[h]; h = after(h)) {
+        used[h] = true;
+        face.push_back(from[h]);
+      }
+      triangulate_monotone();
+    }
+  }
+
+  void emit(int a, int b, int c) {
+    if (orient(a, b, c) < 0) std::swap(b, c);
+    out->push_back(a);
+    out->push_back(b);
+    out->push_back(c);
+  }
+
+  // triangulate `face`, a y-monotone polygon in counter-clockwise order,
+  // with the stack based sweep
+  void triangulate_monotone() {
+    int n = face.size();
+    if (n < 3) return;
+    int top = 0, bottom = 0;
+    for (int i = 1; i < n; i++) {
+      if (above(face[i], face[top])) top = i;
+      if (above(face[bottom], face[i])) bottom = i;
+    }
+    // forward from the top is the left chain and back from it the right
+    // one, both ending at the bottom; merge them top down
+    sorted.clear();
+    int l = top, r = (top + n - 1) % n;
+    for (int k = 0; k < n; k++) {
+      if (l != bottom && above(face[l], face[r])) {
+        chain[face[l]] = 0;
+        sorted.push_back(face[l]);
+        l = (l + 1) % n;
+      } else {
+        chain[face[r]] = 1;
+        sorted.push_back(face[r]);
+        r = (r + n - 1) % n;
+      }
+    }
+
+    stack.clear();
+    stack.push_back(sorted[0]);
+    stack.push_back(sorted[1]);
+    for (int j = 2; j < n - 1; j++) {
+      int u = sorted[j];
+      if (chain[u] != chain[stack.back()]) {
+        for (size_t i = 0; i + 1 < stack.size(); i++)
+          emit(u, stack[i], stack[i + 1]);
+        stack.clear();
+        stack.push_back(sorted[j - 1]);
+      } else {
+        int last = stack.back();
+        stack.pop_back();
+        while (!stack.empty()) {
+          double o = orient(stack.back(), last, u);
+          if (chain[u] == 0 ? o <= 0 : o >= 0) break;
+          emit(stack.back(), last, u);
+          last = stack.back();
+          stack.pop_back();
+        }
+        stack.push_back(last);
+      }
+      stack.push_back(u);
+    }
+    int u = sorted[n - 1];
+    for (size_t i = 0; i + 1 < stack.size(); i++)
+      emit(u, stack[i], stack[i + 1]);
+  }
+};
@@ -0,0 +1,185 @@
+// Builds a BVH over random boxes, some empty, and checks its queries
+// against testing every box: frustum, overlap and raycast, before and after
+// moving items and refitting.
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bvh.hpp"
+
+std::mt19937 rng(3);
+
+float uniform(float lo, float hi) {
+  return std::uniform_real_distribution<float>(lo, hi)(rng);
+}
+
+AABB random_box() {
+  AABB box;
+  if (uniform(0, 1) < 0.05f) return box;  // empty, left out of the tree
+  glm::vec3 c(uniform(-50, 50), uniform(-50, 50), uniform(-50, 50));
+  glm::vec3 half(uniform(0.1f, 2), uniform(0.1f, 2), uniform(0.1f, 2));
+  box.add(c - half);
+  box.add(c + half);
+  return box;
+}
+
+// as BVH::classify, for one box
+int classify(const AABB &box, const Frustum &f) {
+  int result = 1;
+  for (const glm::vec4 &p : f.planes) {
+    glm::vec3 n(p);
+    glm::vec3 ahead(n.x > 0 ? box.max.x : box.min.x,
+                    n.y > 0 ? box.max.y : box.min.y,
+                    n.z > 0 ? box.max.z : box.min.z);
+    glm::vec3 behind(n.x > 0 ? box.min.x : box.max.x,
+                     n.y > 0 ? box.min.y : box.max.y,
+                     n.z > 0 ? box.min.z : box.max.z);
+    if (glm::dot(n, ahead) + p.w < 0.0f) return -1;
+    if (glm::dot(n, behind) + p.w < 0.0f) result = 0;
+  }
+  return result;
+}
+
+// distance along the ray to the box, FLT_MAX when it misses
+float slab(const AABB &box, const glm::vec3 &origin, const glm::vec3 &dir) {
+  float enter = 0.0f, leave = FLT_MAX;
+  for (int i = 0; i < 3; i++) {
+    float a = (box.min[i] - origin[i]) / dir[i];
+    float b = (box.max[i] - origin[i]) / dir[i];
+    if (a > b) std::swap(a, b);
+    enter = std::max(enter, a);
+    leave = std::min(leave, b);
+  }
+  return enter <= leave ? enter : FLT_MAX;
+}
+
+// every node box holds its children or items
+bool nested(const BVH &bvh, const std::vector<AABB> &boxes) {
+  auto holds = [](const AABB &outer, const AABB &inner) {
+    for (int i = 0; i < 3; i++)
+      if (inner.min[i] < outer.min[i] || inner.max[i] > outer.max[i])
+        return false;
+    return true;
+  };
+  for (auto &node : bvh.nodes) {
+    if (node.count == 0) {
+      if (!holds(node.box, bvh.nodes[node.first].box) ||
+          !holds(node.box, bvh.nodes[node.first + 1].box))
+        return false;
+      continue;
+    }
+    for (int j = node.first; j < node.first + node.count; j++)
+      if (!holds(node.box, boxes[bvh.order[j]])) return false;
+  }
+  return true;
+}
+
+bool check(const char *stage, const BVH &bvh,
+           const std::vector<AABB> &boxes) {
+  int n = boxes.size();
+  if (!nested(bvh, boxes)) {
+    std::printf("%s: a node box does not hold its contents\n", stage);
+    return false;
+  }
+
+  // the frustum visits every box reaching into it, and calls a leaf inside
+  // only when all its boxes are
+  for (int view = 0; view < 20; view++) {
+    glm::vec3 eye(uniform(-80, 80), uniform(-80, 80), uniform(-80, 80));
+    glm::mat4 m = glm::perspective(glm::radians(uniform(20, 90)), 1.5f, 0.1f,
+                                   uniform(20, 150)) *
+                  glm::lookAt(eye, glm::vec3(uniform(-20, 20)),
+                              glm::vec3(0, 1, 0));
+    Frustum f = frustum_planes(m);
+    std::vector<char> seen(n, 0);
+    bool ok = true;
+    bvh.frustum(f, [&](const int *items, int count, bool inside) {
+      for (int i = 0; i < count; i++) {
+        seen[items[i]] = 1;
+        if (inside && classify(boxes[items[i]], f) != 1) ok = false;
+      }
+    });
+    for (int i = 0; i < n; i++)
+      if (!boxes[i].empty() && classify(boxes[i], f) >= 0 && !seen[i])
+        ok = false;
+    if (!ok) {
+      std::printf("%s: frustum query %d differs\n", stage, view);
+      return false;
+    }
+  }
+
+  // overlap visits exactly the overlapping boxes
+  for (int q = 0; q < 50; q++) {
+    AABB query = random_box();
+    if (query.empty()) continue;
+    query.min -= glm::vec3(5);
+    query.max += glm::vec3(5);
+    std::vector<char> seen(n, 0);
+    bvh.overlap(query, [&](int item) { seen[item]++; });
+    for (int i = 0; i < n; i++)
+      if (seen[i] != (!boxes[i].empty() && boxes[i].overlaps(query))) {
+        std::printf("%s: overlap query %d differs at item %d\n", stage, q, i);
+        return false;
+      }
+  }
+
+  // raycast finds the nearest box
+  for (int q = 0; q < 200; q++) {
+    glm::vec3 origin(uniform(-60, 60), uniform(-60, 60), uniform(-60, 60));
+    glm::vec3 dir = glm::normalize(
+        glm::vec3(uniform(-1, 1), uniform(-1, 1), uniform(-1, 1)));
+    float nearest = FLT_MAX;
+    for (int i = 0; i < n; i++)
+      if (!boxes[i].empty())
+        nearest = std::min(nearest, slab(boxes[i], origin, dir));
+    float t;
+    int hit = bvh.raycast(origin, dir, t);
+    bool missed = nearest == FLT_MAX;
+    if (missed != (hit < 0) ||
+        (!missed && std::abs(t - nearest) > 1e-4f * (1 + nearest))) {
+      std::printf("%s: ray %d hit at %g, nearest box at %g\n", stage, q, t,
+                  nearest);
+      return false;
+    }
+  }
+  return true;
+}
+
+int main() {
+  std::vector<AABB> boxes(20000);
+  for (auto &b : boxes) b = random_box();
+  BVH bvh;
+  bvh.build(boxes);
+  if (!check("built", bvh, boxes)) return 1;
+
+  // small moves of non-empty items refit in place
+  for (int round = 0; round < 3; round++) {
+    for (int k = 0; k < 2000; k++) {
+      int i = rng() % boxes.size();
+      if (boxes[i].empty()) continue;
+      glm::vec3 step(uniform(-1, 1), uniform(-1, 1), uniform(-1, 1));
+      boxes[i].min += step;
+      boxes[i].max += step;
+      bvh.update(i, boxes[i]);
+    }
+    bvh.refit();
+    if (!check("refit", bvh, boxes)) return 1;
+  }
+
+  // emptying an item needs a build
+  int gone = 0;
+  while (boxes[gone].empty()) gone++;
+  boxes[gone] = AABB();
+  bvh.update(gone, boxes[gone]);
+  if (!bvh.stale()) {
+    std::printf("removing an item did not make the tree stale\n");
+    return 1;
+  }
+  bvh.build(boxes);
+  if (!check("rebuilt", bvh, boxes)) return 1;
+  return 0;
+}
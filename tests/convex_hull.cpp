@@ -0,0 +1,118 @@
+// Hulls random clouds and checks the result: a closed two-manifold whose
+// vertices, edges and faces satisfy Euler's formula, with every point (a
+// spread of 4k for large clouds) behind every face. The clouds are hulled
+// on one thread and, split in chunks merged on a pool, on five.
+// Then times convex_hull on pools of 1 thread up to one per hardware thread,
+// for a filled ball and for points on a sphere, which are all hull corners,
+// and prints the speedup over one thread.
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "hull.hpp"
+
+std::mt19937 rng(7);
+
+// `n` points filling a ball, or on its sphere when `surface` is set
+std::vector<glm::vec3> cloud(size_t n, bool surface) {
+  std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+  std::vector<glm::vec3> points;
+  points.reserve(n);
+  while (points.size() < n) {
+    glm::vec3 p(u(rng), u(rng), u(rng));
+    float d = glm::dot(p, p);
+    if (d > 1.0f || d < 1e-6f) continue;
+    points.push_back(surface ? p / std::sqrt(d) : p);
+  }
+  return points;
+}
+
+bool check(const char *name, const std::vector<glm::vec3> &points,
+           ThreadPool &pool) {
+  std::vector<int> triangles;
+  if (!convex_hull(points, triangles, pool)) {
+    std::printf("%s: rejected as flat\n", name);
+    return false;
+  }
+  // every directed edge once, and its reverse from the face next to it
+  std::map<std::pair<int, int>, int> edges;
+  std::vector<char> corner(points.size(), 0);
+  for (size_t t = 0; t < triangles.size(); t += 3)
+    for (int i = 0; i < 3; i++) {
+      int a = triangles[t + i], b = triangles[t + (i + 1) % 3];
+      edges[std::make_pair(a, b)]++;
+      corner[a] = 1;
+    }
+  for (auto &e : edges)
+    if (e.second != 1 || !edges.count(std::make_pair(e.first.second,
+                                                     e.first.first))) {
+      std::printf("%s: edge %d-%d is not shared by two faces\n", name,
+                  e.first.first, e.first.second);
+      return false;
+    }
+  long long v = 0, e = edges.size() / 2, f = triangles.size() / 3;
+  for (char c : corner) v += c;
+  if (v - e + f != 2) {
+    std::printf("%s: V - E + F = %lld\n", name, v - e + f);
+    return false;
+  }
+  size_t stride = std::max<size_t>(1, points.size() / 4000);
+  for (size_t t = 0; t < triangles.size(); t += 3) {
+    glm::dvec3 a(points[triangles[t]]), b(points[triangles[t + 1]]),
+        c(points[triangles[t + 2]]);
+    glm::dvec3 n = glm::cross(b - a, c - a);
+    double tolerance = 1e-6 * glm::length(n);
+    for (size_t i = 0; i < points.size(); i += stride)
+      if (glm::dot(n, glm::dvec3(points[i]) - a) > tolerance) {
+        std::printf("%s: a point lies in front of face %zu\n", name, t / 3);
+        return false;
+      }
+  }
+  std::printf("%s: %lld vertices, %lld faces\n", name, v, f);
+  return true;
+}
+
+double milliseconds(const std::vector<glm::vec3> &points, ThreadPool &pool) {
+  std::vector<int> triangles;
+  auto start = std::chrono::steady_clock::now();
+  convex_hull(points, triangles, pool);
+  std::chrono::duration<double, std::milli> took =
+      std::chrono::steady_clock::now() - start;
+  return took.count();
+}
+
+int main() {
+  int failed = 0;
+  ThreadPool one(1), five(5);
+  failed += !check("ball of 4", cloud(4, false), one);
+  failed += !check("ball of 50k", cloud(50000, false), one);
+  failed += !check("sphere of 4k", cloud(4000, true), one);
+  // five threads make ten chunks of the ball, merged over three rounds,
+  // and three of the sphere
+  failed += !check("ball of 200k in chunks", cloud(200000, false), five);
+  failed += !check("sphere of 60k in chunks", cloud(60000, true), five);
+  if (failed) return 1;
+
+  int hardware = std::max(1u, std::thread::hardware_concurrency());
+  std::printf("%d hardware threads\n", hardware);
+  for (bool surface : {false, true}) {
+    std::vector<glm::vec3> points = cloud(surface ? 200000 : 2000000,
+                                          surface);
+    std::printf("%s of %zu\n%8s %10s %8s\n", surface ? "sphere" : "ball",
+                points.size(), "threads", "ms", "speedup");
+    double single = 0.0;
+    for (int threads = 1;; threads = std::min(threads * 2, hardware)) {
+      ThreadPool pool(threads);
+      milliseconds(points, pool);  // starts the workers
+      double ms = milliseconds(points, pool);
+      if (threads == 1) single = ms;
+      std::printf("%8d %10.1f %8.2f\n", threads, ms, single / ms);
+      if (threads == hardware) break;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,58 @@
+// Meshes take their data as a Span and upload it straight from the caller's
+// buffers, so building one makes the same few heap allocations (free list
+// nodes of the arena) however many vertices it has. Needs a GL context, from
+// a hidden window.
+#include "engine.hpp"
+
+// a grid of `n` by `n` vertices
+void grid(int n, std::vector<MeshVertex> &vertices,
+          std::vector<GLuint> &indices) {
+  vertices.clear();
+  indices.clear();
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++)
+      vertices.push_back({glm::vec3(i, j, 0.0f) / float(n),
+                          glm::vec3(1.0f), glm::vec2(i, j) / float(n)});
+  for (int i = 0; i + 1 < n; i++)
+    for (int j = 0; j + 1 < n; j++) {
+      GLuint a = i * n + j, b = a + n;
+      for (GLuint k : {a, b, a + 1, a + 1, b, b + 1}) indices.push_back(k);
+    }
+}
+
+// heap allocations made while building a mesh of `vertices`
+uint64_t build(const std::vector<MeshVertex> &vertices,
+               const std::vector<GLuint> &indices, Shader *shader,
+               Texture *texture) {
+  uint64_t start = heap_allocations.load(std::memory_order_relaxed);
+  Mesh mesh(vertices, Span<const GLuint>(indices.data(), indices.size()),
+            GL_TRIANGLES, shader, texture);
+  return heap_allocations.load(std::memory_order_relaxed) - start;
+}
+
+int main() {
+  Game game("mesh allocations", 64, 64, false);
+  Shader *shader =
+      resources.shader("shaders/shader.vert", "shaders/shader.frag");
+  Texture *texture = resources.texture("textures/cement_wall.jpeg");
+
+  std::vector<MeshVertex> small_vertices, large_vertices;
+  std::vector<GLuint> small_indices, large_indices;
+  grid(4, small_vertices, small_indices);
+  grid(100, large_vertices, large_indices);
+
+  // the first build opens the arena page and sizes the packing scratch, and
+  // leaves a transform slot to reuse. All three fit the one page.
+  build(large_vertices, large_indices, shader, texture);
+
+  uint64_t small = build(small_vertices, small_indices, shader, texture);
+  uint64_t large = build(large_vertices, large_indices, shader, texture);
+  std::cout << "heap allocations per mesh: " << small << " for "
+            << small_vertices.size() << " vertices, " << large << " for "
+            << large_vertices.size() << " vertices" << std::endl;
+  if (large != small || small > 8) {
+    std::cerr << "mesh data is copied on the heap" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,186 @@
+// Checks the TransformStore slots (adding, removing and reusing them, and
+// the move logs) and its auto rotation: spin_kernel at every tail length
+// and update() over the thread pool, against glm quaternion products.
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "transform.hpp"
+
+std::mt19937 rng(5);
+
+float uniform(float lo, float hi) {
+  return std::uniform_real_distribution<float>(lo, hi)(rng);
+}
+
+glm::quat random_rotation() {
+  return glm::normalize(glm::quat(uniform(-1, 1), uniform(-1, 1),
+                                  uniform(-1, 1), uniform(-1, 1)));
+}
+
+// a signed unit axis, or zero
+glm::vec3 random_axis() {
+  int axis = int(rng() % 7) - 3;
+  glm::vec3 a(0.0f);
+  if (axis) a[std::abs(axis) - 1] = axis < 0 ? -1.0f : 1.0f;
+  return a;
+}
+
+// the rotations are the same up to rounding
+bool near(const glm::quat &a, const glm::quat &b) {
+  return std::abs(a.w - b.w) < 1e-6f && std::abs(a.x - b.x) < 1e-6f &&
+         std::abs(a.y - b.y) < 1e-6f && std::abs(a.z - b.z) < 1e-6f;
+}
+
+// times `h` is in the log
+int logged(const TransformStore &store, int log, TransformHandle h) {
+  const std::vector<TransformHandle> &moved = store.moved(log);
+  return std::count(moved.begin(), moved.end(), h);
+}
+
+bool check_slots() {
+  TransformStore store;
+  int log = store.watch();
+  TransformHandle a = store.add(), b = store.add(), c = store.add();
+  if (a != 0 || b != 1 || c != 2 || store.size() != 3) {
+    std::printf("new slots are not appended\n");
+    return false;
+  }
+  for (TransformHandle h : {a, b, c})
+    if (!store.visible[h] || logged(store, log, h) != 1 || store.spinning[h] ||
+        store.model(h) != glm::mat4(1.0f)) {
+      std::printf("slot %u does not start still at the origin\n", h);
+      return false;
+    }
+
+  // a log opened later sees only later moves, and clearing one log leaves
+  // the other alone
+  int late = store.watch();
+  store.clear_moved(log);
+  store.set_position(b, glm::vec3(1, 2, 3));
+  store.set_position(b, glm::vec3(1, 2, 3));
+  if (store.moved(log).size() != 1 || logged(store, log, b) != 1 ||
+      store.moved(late) != store.moved(log) ||
+      store.position(b) != glm::vec3(1, 2, 3)) {
+    std::printf("set_position does not log only its slot, once\n");
+    return false;
+  }
+  store.clear_moved(log);
+  store.rotate(c, glm::vec3(0, 0, 1), 90.0f);
+  if (store.moved(log).size() != 1 || logged(store, log, c) != 1 ||
+      store.moved(late).size() != 2 ||
+      !near(store.rotation(c),
+            glm::angleAxis(glm::radians(90.0f), glm::vec3(0, 0, 1)))) {
+    std::printf("rotate does not turn and log its slot\n");
+    return false;
+  }
+
+  store.reshape(a);
+  store.reshape(a);
+  if (store.reshaped != std::vector<TransformHandle>{a}) {
+    std::printf("a reshaped slot is not listed once\n");
+    return false;
+  }
+  store.clear_reshaped();
+  store.reshape(a);
+  if (store.reshaped.size() != 1) {
+    std::printf("a slot is not listed again after clear_reshaped\n");
+    return false;
+  }
+
+  store.spin(b, -2);
+  store.remove(b);
+  if (store.visible[b] || store.spinning[b]) {
+    std::printf("a removed slot stays visible or spinning\n");
+    return false;
+  }
+  store.remove(NO_TRANSFORM);
+  TransformHandle d = store.add();
+  if (d != b || store.size() != 3 || !store.visible[d] ||
+      store.model(d) != glm::mat4(1.0f)) {
+    std::printf("the removed slot is not reused reset\n");
+    return false;
+  }
+  if (store.add() != 3) {
+    std::printf("a slot is handed out twice\n");
+    return false;
+  }
+  return true;
+}
+
+// spin_kernel against glm for every count up to a few vectors, so each
+// vector width meets every tail length, and at offsets into the arrays
+bool check_kernel() {
+  const float c = std::cos(0.3f), s = std::sin(0.3f);
+  for (size_t count = 0; count <= 40; count++)
+    for (size_t offset = 0; offset < 3; offset++) {
+      size_t n = offset + count;
+      std::vector<float> ax(n), ay(n), az(n), w(n), x(n), y(n), z(n);
+      std::vector<glm::quat> expected(n);
+      for (size_t i = 0; i < n; i++) {
+        glm::vec3 axis = random_axis();
+        glm::quat q = random_rotation();
+        ax[i] = axis.x, ay[i] = axis.y, az[i] = axis.z;
+        w[i] = q.w, x[i] = q.x, y[i] = q.y, z[i] = q.z;
+        glm::quat turn =
+            axis == glm::vec3(0.0f) ? glm::quat(1, 0, 0, 0)
+                                    : glm::quat(c, s * axis.x, s * axis.y,
+                                                s * axis.z);
+        expected[i] = i < offset ? q : glm::normalize(q * turn);
+      }
+      spin_kernel(c, s, &ax[offset], &ay[offset], &az[offset], &w[offset],
+                  &x[offset], &y[offset], &z[offset], count);
+      for (size_t i = 0; i < n; i++)
+        if (!near(glm::quat(w[i], x[i], y[i], z[i]), expected[i])) {
+          std::printf("spin_kernel of %zu at offset %zu is off at %zu\n",
+                      count, offset, i);
+          return false;
+        }
+    }
+  return true;
+}
+
+// update() over more slots than one pool chunk: spinning slots turn a
+// degree and are logged as moved, the others are left alone
+bool check_update() {
+  TransformStore store;
+  int log = store.watch();
+  std::vector<glm::quat> expected;
+  for (int i = 0; i < 50000; i++) {
+    TransformHandle h = store.add();
+    glm::quat q = random_rotation();
+    store.set_rotation(h, q);
+    int axis = int(rng() % 7) - 3;
+    store.spin(h, axis);
+    glm::vec3 a(store.spin_x[h], store.spin_y[h], store.spin_z[h]);
+    expected.push_back(axis ? glm::normalize(q * glm::angleAxis(
+                                                     glm::radians(1.0f), a))
+                            : q);
+  }
+  store.clear_moved(log);
+  store.update();
+  std::vector<int> moved(store.size(), 0);
+  for (TransformHandle h : store.moved(log)) moved[h]++;
+  for (size_t i = 0; i < store.size(); i++) {
+    bool spinning = store.spinning[i];
+    if (moved[i] != spinning) {
+      std::printf("slot %zu: logged %d times after update\n", i, moved[i]);
+      return false;
+    }
+    if (!near(store.rotation(i), expected[i])) {
+      std::printf("slot %zu %s off the glm rotation\n", i,
+                  spinning ? "spins" : "stands still but is turned");
+      return false;
+    }
+  }
+  return true;
+}
+
+int main() {
+  int failed = 0;
+  failed += !check_slots();
+  failed += !check_kernel();
+  failed += !check_update();
+  return failed ? 1 : 0;
+}
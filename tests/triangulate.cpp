@@ -0,0 +1,119 @@
+// Triangulates random polygons, concave and with holes, and checks that
+// every one gives n - 2 + 2h counter-clockwise triangles covering exactly
+// the polygon's area.
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "triangulate.hpp"
+
+std::mt19937 rng(42);
+
+float uniform(float lo, float hi) {
+  return std::uniform_real_distribution<float>(lo, hi)(rng);
+}
+
+// a star-shaped polygon around `center`: random radii at increasing angles
+std::vector<glm::vec2> star(glm::vec2 center, int n, float lo, float hi,
+                            bool clockwise) {
+  std::vector<glm::vec2> c;
+  for (int i = 0; i < n; i++) {
+    float angle = 2 * float(M_PI) * (i + uniform(0.1f, 0.9f)) / n;
+    if (clockwise) angle = -angle;
+    float r = uniform(lo, hi);
+    c.push_back(center + glm::vec2(r * std::cos(angle), r * std::sin(angle)));
+  }
+  return c;
+}
+
+// a comb whose teeth share their y coordinates, to hit ties in the sweep
+std::vector<glm::vec2> comb(int teeth) {
+  std::vector<glm::vec2> c = {glm::vec2(0, 0), glm::vec2(2 * teeth, 0)};
+  for (int t = teeth - 1; t >= 0; t--) {
+    c.push_back(glm::vec2(2 * t + 1.0f, 3));
+    c.push_back(glm::vec2(2 * t + 0.5f, 1));
+    c.push_back(glm::vec2(2 * t, 3));
+  }
+  c.push_back(glm::vec2(0, 1));
+  return c;
+}
+
+double signed_area(const std::vector<glm::vec2> &c) {
+  double a = 0.0;
+  for (size_t i = 0; i < c.size(); i++) {
+    const glm::vec2 &p = c[i], &q = c[(i + 1) % c.size()];
+    a += double(p.x) * q.y - double(q.x) * p.y;
+  }
+  return a / 2;
+}
+
+// whether the polygon triangulates into the expected triangles
+bool check(const char *name, const Contours &contours) {
+  std::vector<glm::vec2> points;
+  double area = 0.0;
+  for (size_t i = 0; i < contours.size(); i++) {
+    double a = std::abs(signed_area(contours[i]));
+    area += i == 0 ? a : -a;
+    points.insert(points.end(), contours[i].begin(), contours[i].end());
+  }
+  size_t holes = contours.size() - 1;
+
+  Triangulator triangulator;
+  std::vector<unsigned int> triangles;
+  if (!triangulator.triangulate(contours, triangles)) {
+    std::printf("%s: rejected as not simple\n", name);
+    return false;
+  }
+  size_t expected = points.size() - 2 + 2 * holes;
+  if (triangles.size() != 3 * expected) {
+    std::printf("%s: %zu triangles, expected %zu\n", name,
+                triangles.size() / 3, expected);
+    return false;
+  }
+  double covered = 0.0;
+  for (size_t t = 0; t < triangles.size(); t += 3) {
+    double a = signed_area({points[triangles[t]], points[triangles[t + 1]],
+                            points[triangles[t + 2]]});
+    if (a < 0.0) {
+      std::printf("%s: triangle %zu is clockwise\n", name, t / 3);
+      return false;
+    }
+    covered += a;
+  }
+  if (std::abs(covered - area) > 1e-4 * area) {
+    std::printf("%s: triangles cover %g of %g\n", name, covered, area);
+    return false;
+  }
+  return true;
+}
+
+int main() {
+  int failed = 0;
+  failed += !check("comb", {comb(50)});
+
+  for (int round = 0; round < 200; round++) {
+    char name[64];
+    int n = 3 + round * 10;
+    std::snprintf(name, sizeof(name), "star of %d", n);
+    failed += !check(name, {star(glm::vec2(0), n, 0.5f, 1.0f, round & 1)});
+
+    // holes on a grid inside the unit square, which an outline of at least
+    // 16 corners between radii 0.95 and 1 always contains
+    Contours contours = {star(glm::vec2(0), n + 13, 0.95f, 1.0f, false)};
+    int grid = 1 + round % 5;
+    float cell = 1.0f / grid;
+    for (int i = 0; i < grid; i++)
+      for (int j = 0; j < grid; j++) {
+        glm::vec2 center(-0.5f + cell * (i + 0.5f), -0.5f + cell * (j + 0.5f));
+        contours.push_back(
+            star(center, 3 + (i + j + round) % 12, 0.1f * cell, 0.4f * cell,
+                 (i + j) & 1));
+      }
+    std::snprintf(name, sizeof(name), "star of %d with %d holes", n + 13,
+                  grid * grid);
+    failed += !check(name, contours);
+  }
+  if (failed) std::printf("%d polygons failed\n", failed);
+  return failed ? 1 : 0;
+}